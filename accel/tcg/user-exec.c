@@ -24,6 +24,7 @@
 #include "tcg/tcg.h"
 #include "qemu/bitops.h"
 #include "qemu/rcu.h"
+#include "qemu/seqlock.h"
 #include "accel/tcg/cpu-ldst-common.h"
 #include "accel/tcg/helper-retaddr.h"
 #include "accel/tcg/probe.h"
@@ -162,6 +163,15 @@ typedef struct PageFlagsNode {
 
 static IntervalTreeRoot pageflags_root;
 
+/*
+ * Bumped around every modification of pageflags_root, all of which are
+ * done with the mmap_lock held.  See util/interval-tree.c re lockless
+ * lookups: no false positives but there are false negatives, and only
+ * while the tree is being modified.  A lockless miss is therefore
+ * reliable unless it overlapped a modification.
+ */
+static QemuSeqLock pageflags_seq;
+
 static PageFlagsNode *pageflags_find(vaddr start, vaddr last)
 {
     IntervalTreeNode *n;
@@ -170,6 +180,20 @@ static PageFlagsNode *pageflags_find(vaddr start, vaddr last)
     return n ? container_of(n, PageFlagsNode, itree) : NULL;
 }
 
+/*
+ * Lockless lookup of [start,last] into *PP.  Return false if the result
+ * may be a false negative, and the lookup must be repeated with the
+ * mmap_lock held.
+ */
+static bool pageflags_find_unlocked(vaddr start, vaddr last,
+                                    PageFlagsNode **pp)
+{
+    unsigned seq = seqlock_read_begin(&pageflags_seq);
+
+    *pp = pageflags_find(start, last);
+    return *pp || !seqlock_read_retry(&pageflags_seq, seq);
+}
+
 static PageFlagsNode *pageflags_next(PageFlagsNode *p, vaddr start, vaddr last)
 {
     IntervalTreeNode *n;
@@ -233,18 +257,10 @@ void page_dump(FILE *f)
 
 int page_get_flags(vaddr address)
 {
-    PageFlagsNode *p = pageflags_find(address, address);
+    PageFlagsNode *p;
 
-    /*
-     * See util/interval-tree.c re lockless lookups: no false positives but
-     * there are false negatives.  If we find nothing, retry with the mmap
-     * lock acquired.
-     */
-    if (p) {
-        return p->flags;
-    }
-    if (have_mmap_lock()) {
-        return 0;
+    if (pageflags_find_unlocked(address, address, &p)) {
+        return p ? p->flags : 0;
     }
 
     mmap_lock();
@@ -529,12 +545,16 @@ void page_set_flags(vaddr start, vaddr last, int flags)
 
     if (!flags || reset) {
         page_reset_target_data(start, last);
+    }
+    seqlock_write_begin(&pageflags_seq);
+    if (!flags || reset) {
         inval_tb |= pageflags_unset(start, last);
     }
     if (flags) {
         inval_tb |= pageflags_set_clear(start, last, flags,
                                         ~(reset ? 0 : PAGE_STICKY));
     }
+    seqlock_write_end(&pageflags_seq);
     if (inval_tb) {
         tb_invalidate_phys_range(NULL, start, last);
     }
@@ -557,23 +577,18 @@ bool page_check_range(vaddr start, vaddr len, int flags)
 
     locked = have_mmap_lock();
     while (true) {
-        PageFlagsNode *p = pageflags_find(start, last);
+        PageFlagsNode *p;
         int missing;
 
+        if (!pageflags_find_unlocked(start, last, &p) && !locked) {
+            /* Possible false negative, retry with the lock held. */
+            mmap_lock();
+            locked = -1;
+            p = pageflags_find(start, last);
+        }
         if (!p) {
-            if (!locked) {
-                /*
-                 * Lockless lookups have false negatives.
-                 * Retry with the lock held.
-                 */
-                mmap_lock();
-                locked = -1;
-                p = pageflags_find(start, last);
-            }
-            if (!p) {
-                ret = false; /* entire region invalid */
-                break;
-            }
+            ret = false; /* entire region invalid */
+            break;
         }
         if (start < p->itree.start) {
             ret = false; /* initial bytes invalid */
@@ -697,7 +712,9 @@ void tb_lock_page0(tb_page_addr_t address)
     }
 
     if (prot & PAGE_WRITE) {
+        seqlock_write_begin(&pageflags_seq);
         pageflags_set_clear(start, last, 0, PAGE_WRITE);
+        seqlock_write_end(&pageflags_seq);
         mprotect(g2h_untagged(start), last - start + 1,
                  prot & (PAGE_READ | PAGE_EXEC) ? PROT_READ : PROT_NONE);
     }
@@ -754,7 +771,9 @@ int page_unprotect(CPUState *cpu, tb_page_addr_t address, uintptr_t pc)
             start = address & TARGET_PAGE_MASK;
             len = TARGET_PAGE_SIZE;
             prot = p->flags | PAGE_WRITE;
+            seqlock_write_begin(&pageflags_seq);
             pageflags_set_clear(start, start + len - 1, PAGE_WRITE, 0);
+            seqlock_write_end(&pageflags_seq);
             current_tb_invalidated =
                 tb_invalidate_phys_page_unwind(cpu, start, pc);
         } else {
@@ -770,8 +789,10 @@ int page_unprotect(CPUState *cpu, tb_page_addr_t address, uintptr_t pc)
                     prot |= p->flags;
                     if (p->flags & PAGE_WRITE_ORG) {
                         prot |= PAGE_WRITE;
+                        seqlock_write_begin(&pageflags_seq);
                         pageflags_set_clear(addr, addr + TARGET_PAGE_SIZE - 1,
                                             PAGE_WRITE, 0);
+                        seqlock_write_end(&pageflags_seq);
                     }
                 }
                 /*
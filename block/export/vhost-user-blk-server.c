@@ -10,6 +10,7 @@
  * later.  See the COPYING file in the top-level directory.
  */
 #include "qemu/osdep.h"
+#include "qemu/defer-call.h"
 #include "qemu/error-report.h"
 #include "block/block.h"
 #include "subprojects/libvhost-user/libvhost-user.h" /* only for the type definitions */
@@ -45,7 +46,7 @@ static void vu_blk_req_complete(VuBlkReq *req, size_t in_len)
     VuDev *vu_dev = &req->server->vu_dev;
 
     vu_queue_push(vu_dev, req->vq, &req->elem, in_len);
-    vu_queue_notify(vu_dev, req->vq);
+    vhost_user_server_queue_notify(req->server, req->vq);
 
     free(req);
 }
@@ -83,24 +84,41 @@ static void vu_blk_process_vq(VuDev *vu_dev, int idx)
 {
     VuServer *server = container_of(vu_dev, VuServer, vu_dev);
     VuVirtq *vq = vu_get_queue(vu_dev, idx);
+    /* Already off while the AioContext polls the ring */
+    bool suppress_notifications = vq->notification;
 
-    while (1) {
-        VuBlkReq *req;
+    /* Batch I/O submission and used ring notifications */
+    defer_call_begin();
 
-        req = vu_queue_pop(vu_dev, vq, sizeof(VuBlkReq));
-        if (!req) {
-            break;
+    do {
+        if (suppress_notifications) {
+            vu_queue_set_notification(vu_dev, vq, 0);
         }
 
-        req->server = server;
-        req->vq = vq;
+        while (1) {
+            VuBlkReq *req;
 
-        Coroutine *co =
-            qemu_coroutine_create(vu_blk_virtio_process_req, req);
+            req = vu_queue_pop(vu_dev, vq, sizeof(VuBlkReq));
+            if (!req) {
+                break;
+            }
 
-        vhost_user_server_inc_in_flight(server);
-        qemu_coroutine_enter(co);
-    }
+            req->server = server;
+            req->vq = vq;
+
+            Coroutine *co =
+                qemu_coroutine_create(vu_blk_virtio_process_req, req);
+
+            vhost_user_server_inc_in_flight(server);
+            qemu_coroutine_enter(co);
+        }
+
+        if (suppress_notifications) {
+            vu_queue_set_notification(vu_dev, vq, 1);
+        }
+    } while (!vu_queue_empty(vu_dev, vq));
+
+    defer_call_end();
 }
 
 static void vu_blk_queue_set_started(VuDev *vu_dev, int idx, bool started)
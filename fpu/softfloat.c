@@ -396,6 +396,177 @@ float64_gen2(float64 xa, float64 xb, float_status *s,
     return soft(ua.s, ub.s, s);
 }
 
+/*
+ * float16 and bfloat16 operations are computed on the host in float32.
+ * Widening the operands is exact and float32 has at least 2p + 2 bits of
+ * precision for both formats, so rounding the float32 result of add, sub,
+ * mul, div and sqrt again to the narrow format gives the correctly rounded
+ * result.  Anything that is not a normal number in the narrow format is
+ * left to softfloat.
+ */
+
+typedef bool (*f16_check_fn)(float16 a, float16 b);
+typedef bool (*bf16_check_fn)(bfloat16 a, bfloat16 b);
+
+typedef float16  (*soft_f16_op2_fn)(float16 a, float16 b, float_status *s);
+typedef bfloat16 (*soft_bf16_op2_fn)(bfloat16 a, bfloat16 b, float_status *s);
+
+static inline bool float16_is_zero_or_normal(float16 a)
+{
+    return float16_is_normal(a) || float16_is_zero(a);
+}
+
+static inline bool bfloat16_is_zero_or_normal(bfloat16 a)
+{
+    return bfloat16_is_normal(a) || bfloat16_is_zero(a);
+}
+
+/* Widen a zero or normal float16 */
+static inline float32 f16_widen(float16 a)
+{
+    uint32_t v = float16_val(a);
+    uint32_t sign = (v & 0x8000) << 16;
+
+    if (!(v & 0x7fff)) {
+        return make_float32(sign);
+    }
+    return make_float32(sign | (((v & 0x7fff) + ((127 - 15) << 10)) << 13));
+}
+
+/* Widen a zero or normal bfloat16 */
+static inline float32 bf16_widen(bfloat16 a)
+{
+    return make_float32((uint32_t)a << 16);
+}
+
+/*
+ * Round a zero or normal float32 to nearest even float16.  Returns false
+ * if the result would not be zero or normal, or might be tiny.
+ */
+static inline bool f16_narrow(float32 a, float16 *r, float_status *s)
+{
+    uint32_t v = float32_val(a);
+    uint32_t sign = (v >> 16) & 0x8000;
+    uint32_t mag = v & 0x7fffffff;
+    uint32_t h, rem;
+
+    if (mag == 0) {
+        *r = make_float16(sign);
+        return true;
+    }
+    if (mag < (127 - 14) << 23) {
+        return false;
+    }
+
+    h = (mag - ((127 - 15) << 23)) >> 13;
+    rem = mag & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1))) {
+        h++;
+    }
+    if (h <= 0x0400 || h >= 0x7c00) {
+        return false;
+    }
+    if (rem) {
+        float_raise(float_flag_inexact, s);
+    }
+    *r = make_float16(sign | h);
+    return true;
+}
+
+/* As f16_narrow, for bfloat16 */
+static inline bool bf16_narrow(float32 a, bfloat16 *r, float_status *s)
+{
+    uint32_t v = float32_val(a);
+    uint32_t sign = (v >> 16) & 0x8000;
+    uint32_t mag = v & 0x7fffffff;
+    uint32_t h, rem;
+
+    if (mag == 0) {
+        *r = sign;
+        return true;
+    }
+
+    h = mag >> 16;
+    rem = mag & 0xffff;
+    if (rem > 0x8000 || (rem == 0x8000 && (h & 1))) {
+        h++;
+    }
+    if (h <= 0x0080 || h >= 0x7f80) {
+        return false;
+    }
+    if (rem) {
+        float_raise(float_flag_inexact, s);
+    }
+    *r = sign | h;
+    return true;
+}
+
+static inline float16
+float16_gen2(float16 a, float16 b, float_status *s,
+             hard_f32_op2_fn hard, soft_f16_op2_fn soft, f16_check_fn pre)
+{
+    union_float32 ua, ub, ur;
+    float16 r;
+
+    if (unlikely(!can_use_fpu(s)) || unlikely(!pre(a, b))) {
+        goto soft;
+    }
+
+    ua.s = f16_widen(a);
+    ub.s = f16_widen(b);
+    ur.h = hard(ua.h, ub.h);
+    if (unlikely(!f16_narrow(ur.s, &r, s))) {
+        goto soft;
+    }
+    return r;
+
+ soft:
+    return soft(a, b, s);
+}
+
+static inline bfloat16
+bfloat16_gen2(bfloat16 a, bfloat16 b, float_status *s,
+              hard_f32_op2_fn hard, soft_bf16_op2_fn soft, bf16_check_fn pre)
+{
+    union_float32 ua, ub, ur;
+    bfloat16 r;
+
+    if (unlikely(!can_use_fpu(s)) || unlikely(!pre(a, b))) {
+        goto soft;
+    }
+
+    ua.s = bf16_widen(a);
+    ub.s = bf16_widen(b);
+    ur.h = hard(ua.h, ub.h);
+    if (unlikely(!bf16_narrow(ur.s, &r, s))) {
+        goto soft;
+    }
+    return r;
+
+ soft:
+    return soft(a, b, s);
+}
+
+static bool f16_is_zon2(float16 a, float16 b)
+{
+    return float16_is_zero_or_normal(a) && float16_is_zero_or_normal(b);
+}
+
+static bool bf16_is_zon2(bfloat16 a, bfloat16 b)
+{
+    return bfloat16_is_zero_or_normal(a) && bfloat16_is_zero_or_normal(b);
+}
+
+static bool f16_div_pre(float16 a, float16 b)
+{
+    return float16_is_zero_or_normal(a) && float16_is_normal(b);
+}
+
+static bool bf16_div_pre(bfloat16 a, bfloat16 b)
+{
+    return bfloat16_is_zero_or_normal(a) && bfloat16_is_normal(b);
+}
+
 /*
  * Classify a floating point number. Everything above float_class_qnan
  * is a NaN so cls >= float_class_qnan is any NaN.
@@ -1898,12 +2069,12 @@ float16_addsub(float16 a, float16 b, float_status *status, bool subtract)
     return float16_round_pack_canonical(pr, status);
 }
 
-float16 float16_add(float16 a, float16 b, float_status *status)
+static float16 soft_f16_add(float16 a, float16 b, float_status *status)
 {
     return float16_addsub(a, b, status, false);
 }
 
-float16 float16_sub(float16 a, float16 b, float_status *status)
+static float16 soft_f16_sub(float16 a, float16 b, float_status *status)
 {
     return float16_addsub(a, b, status, true);
 }
@@ -2061,16 +2232,40 @@ bfloat16_addsub(bfloat16 a, bfloat16 b, float_status *status, bool subtract)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
-bfloat16 bfloat16_add(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 soft_bf16_add(bfloat16 a, bfloat16 b, float_status *status)
 {
     return bfloat16_addsub(a, b, status, false);
 }
 
-bfloat16 bfloat16_sub(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 soft_bf16_sub(bfloat16 a, bfloat16 b, float_status *status)
 {
     return bfloat16_addsub(a, b, status, true);
 }
 
+float16 QEMU_FLATTEN
+float16_add(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_add, soft_f16_add, f16_is_zon2);
+}
+
+float16 QEMU_FLATTEN
+float16_sub(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_sub, soft_f16_sub, f16_is_zon2);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_add(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_add, soft_bf16_add, bf16_is_zon2);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_sub(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_sub, soft_bf16_sub, bf16_is_zon2);
+}
+
 static float128 QEMU_FLATTEN
 float128_addsub(float128 a, float128 b, float_status *status, bool subtract)
 {
@@ -2121,7 +2316,8 @@ floatx80 floatx80_sub(floatx80 a, floatx80 b, float_status *status)
  * Multiplication
  */
 
-float16 QEMU_FLATTEN float16_mul(float16 a, float16 b, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_mul(float16 a, float16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2191,8 +2387,8 @@ float64 float64r32_mul(float64 a, float64 b, float_status *status)
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN
-bfloat16_mul(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_mul(bfloat16 a, bfloat16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2203,6 +2399,18 @@ bfloat16_mul(bfloat16 a, bfloat16 b, float_status *status)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+float16 QEMU_FLATTEN
+float16_mul(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_mul, soft_f16_mul, f16_is_zon2);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_mul(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_mul, soft_bf16_mul, bf16_is_zon2);
+}
+
 float128 QEMU_FLATTEN
 float128_mul(float128 a, float128 b, float_status *status)
 {
@@ -2495,7 +2703,8 @@ float128 QEMU_FLATTEN float128_muladd(float128 a, float128 b, float128 c,
  * Division
  */
 
-float16 float16_div(float16 a, float16 b, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_div(float16 a, float16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2599,8 +2808,8 @@ float64 float64r32_div(float64 a, float64 b, float_status *status)
     return float64r32_round_pack_canonical(pr, status);
 }
 
-bfloat16 QEMU_FLATTEN
-bfloat16_div(bfloat16 a, bfloat16 b, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_div(bfloat16 a, bfloat16 b, float_status *status)
 {
     FloatParts64 pa, pb, *pr;
 
@@ -2611,6 +2820,18 @@ bfloat16_div(bfloat16 a, bfloat16 b, float_status *status)
     return bfloat16_round_pack_canonical(pr, status);
 }
 
+float16 QEMU_FLATTEN
+float16_div(float16 a, float16 b, float_status *s)
+{
+    return float16_gen2(a, b, s, hard_f32_div, soft_f16_div, f16_div_pre);
+}
+
+bfloat16 QEMU_FLATTEN
+bfloat16_div(bfloat16 a, bfloat16 b, float_status *s)
+{
+    return bfloat16_gen2(a, b, s, hard_f32_div, soft_bf16_div, bf16_div_pre);
+}
+
 float128 QEMU_FLATTEN
 float128_div(float128 a, float128 b, float_status *status)
 {
@@ -2828,6 +3049,11 @@ float32 float16_to_float32(float16 a, bool ieee, float_status *s)
     const FloatFmt *fmt16 = ieee ? &float16_params : &float16_params_ahp;
     FloatParts64 p;
 
+    /* Widening conversion can never produce inexact results.  */
+    if (likely(float16_is_zero_or_normal(a))) {
+        return f16_widen(a);
+    }
+
     float16a_unpack_canonical(&p, a, s, fmt16);
     parts_float_to_float(&p, s);
     return float32_round_pack_canonical(&p, s);
@@ -2838,6 +3064,10 @@ float64 float16_to_float64(float16 a, bool ieee, float_status *s)
     const FloatFmt *fmt16 = ieee ? &float16_params : &float16_params_ahp;
     FloatParts64 p;
 
+    if (likely(float16_is_zero_or_normal(a))) {
+        return float32_to_float64(f16_widen(a), s);
+    }
+
     float16a_unpack_canonical(&p, a, s, fmt16);
     parts_float_to_float(&p, s);
     return float64_round_pack_canonical(&p, s);
@@ -2847,6 +3077,12 @@ float16 float32_to_float16(float32 a, bool ieee, float_status *s)
 {
     FloatParts64 p;
     const FloatFmt *fmt;
+    float16 r;
+
+    if (likely(ieee && s->float_rounding_mode == float_round_nearest_even &&
+               float32_is_zero_or_normal(a) && f16_narrow(a, &r, s))) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     if (ieee) {
@@ -2901,7 +3137,8 @@ float16 float64_to_float16(float64 a, bool ieee, float_status *s)
     return float16a_round_pack_canonical(&p, s, fmt);
 }
 
-float32 float64_to_float32(float64 a, float_status *s)
+static float32 QEMU_SOFTFLOAT_ATTR
+soft_float64_to_float32(float64 a, float_status *s)
 {
     FloatParts64 p;
 
@@ -2910,10 +3147,42 @@ float32 float64_to_float32(float64 a, float_status *s)
     return float32_round_pack_canonical(&p, s);
 }
 
+float32 float64_to_float32(float64 a, float_status *s)
+{
+    union_float64 ua;
+    union_float32 ur;
+
+    ua.s = a;
+    if (unlikely(!can_use_fpu(s))) {
+        goto soft;
+    }
+
+    float64_input_flush1(&ua.s, s);
+    if (unlikely(!float64_is_zero_or_normal(ua.s))) {
+        goto soft;
+    }
+
+    ur.h = ua.h;
+    if (unlikely(f32_is_inf(ur))) {
+        float_raise(float_flag_overflow, s);
+    } else if (unlikely(fabsf(ur.h) <= FLT_MIN) && !float64_is_zero(ua.s)) {
+        goto soft;
+    }
+    return ur.s;
+
+ soft:
+    return soft_float64_to_float32(ua.s, s);
+}
+
 float32 bfloat16_to_float32(bfloat16 a, float_status *s)
 {
     FloatParts64 p;
 
+    /* Widening conversion can never produce inexact results.  */
+    if (likely(bfloat16_is_zero_or_normal(a))) {
+        return bf16_widen(a);
+    }
+
     bfloat16_unpack_canonical(&p, a, s);
     parts_float_to_float(&p, s);
     return float32_round_pack_canonical(&p, s);
@@ -2923,6 +3192,10 @@ float64 bfloat16_to_float64(bfloat16 a, float_status *s)
 {
     FloatParts64 p;
 
+    if (likely(bfloat16_is_zero_or_normal(a))) {
+        return float32_to_float64(bf16_widen(a), s);
+    }
+
     bfloat16_unpack_canonical(&p, a, s);
     parts_float_to_float(&p, s);
     return float64_round_pack_canonical(&p, s);
@@ -2931,6 +3204,12 @@ float64 bfloat16_to_float64(bfloat16 a, float_status *s)
 bfloat16 float32_to_bfloat16(float32 a, float_status *s)
 {
     FloatParts64 p;
+    bfloat16 r;
+
+    if (likely(s->float_rounding_mode == float_round_nearest_even &&
+               float32_is_zero_or_normal(a) && bf16_narrow(a, &r, s))) {
+        return r;
+    }
 
     float32_unpack_canonical(&p, a, s);
     parts_float_to_float(&p, s);
@@ -4668,11 +4947,251 @@ floatx80 floatx80_scalbn(floatx80 a, int n, float_status *status)
     return floatx80_round_pack_canonical(&p, status);
 }
 
+/*
+ * Batch operations
+ *
+ * These compute n independent elements, as needed by vector instructions.
+ * When hardfloat can be used, a chunk of elements is first computed on the
+ * host in a loop that the compiler can vectorize, noting the lanes whose
+ * operands or result hardfloat cannot handle.  Only those lanes are then
+ * computed again with the scalar function, which raises their flags.
+ * The destination may overlap the operands.
+ */
+
+#define SOFTFLOAT_BATCH 64
+
+static inline void
+float32_batch2(float32 *d, const float32 *a, const float32 *b, size_t n,
+               float_status *s, hard_f32_op2_fn hard, soft_f32_op2_fn scalar,
+               f32_check_fn pre, f32_check_fn post)
+{
+    while (n) {
+        size_t i, len = MIN(n, SOFTFLOAT_BATCH);
+        union_float32 r[SOFTFLOAT_BATCH];
+        bool redo[SOFTFLOAT_BATCH];
+        bool any_redo = false;
+
+        if (unlikely(!can_use_fpu(s))) {
+            for (i = 0; i < len; i++) {
+                r[i].s = scalar(a[i], b[i], s);
+            }
+        } else {
+            for (i = 0; i < len; i++) {
+                union_float32 ua = { .s = a[i] }, ub = { .s = b[i] };
+
+                r[i].h = hard(ua.h, ub.h);
+                redo[i] = !pre(ua, ub) || f32_is_inf(r[i]) ||
+                          (fabsf(r[i].h) <= FLT_MIN && post(ua, ub));
+                any_redo |= redo[i];
+            }
+            if (unlikely(any_redo)) {
+                for (i = 0; i < len; i++) {
+                    if (redo[i]) {
+                        r[i].s = scalar(a[i], b[i], s);
+                    }
+                }
+            }
+        }
+
+        memcpy(d, r, len * sizeof(*d));
+        d += len;
+        a += len;
+        b += len;
+        n -= len;
+    }
+}
+
+static inline void
+float64_batch2(float64 *d, const float64 *a, const float64 *b, size_t n,
+               float_status *s, hard_f64_op2_fn hard, soft_f64_op2_fn scalar,
+               f64_check_fn pre, f64_check_fn post)
+{
+    while (n) {
+        size_t i, len = MIN(n, SOFTFLOAT_BATCH);
+        union_float64 r[SOFTFLOAT_BATCH];
+        bool redo[SOFTFLOAT_BATCH];
+        bool any_redo = false;
+
+        if (unlikely(!can_use_fpu(s))) {
+            for (i = 0; i < len; i++) {
+                r[i].s = scalar(a[i], b[i], s);
+            }
+        } else {
+            for (i = 0; i < len; i++) {
+                union_float64 ua = { .s = a[i] }, ub = { .s = b[i] };
+
+                r[i].h = hard(ua.h, ub.h);
+                redo[i] = !pre(ua, ub) || f64_is_inf(r[i]) ||
+                          (fabs(r[i].h) <= DBL_MIN && post(ua, ub));
+                any_redo |= redo[i];
+            }
+            if (unlikely(any_redo)) {
+                for (i = 0; i < len; i++) {
+                    if (redo[i]) {
+                        r[i].s = scalar(a[i], b[i], s);
+                    }
+                }
+            }
+        }
+
+        memcpy(d, r, len * sizeof(*d));
+        d += len;
+        a += len;
+        b += len;
+        n -= len;
+    }
+}
+
+void float32_add_batch(float32 *d, const float32 *a, const float32 *b,
+                       size_t n, float_status *s)
+{
+    float32_batch2(d, a, b, n, s, hard_f32_add, float32_add,
+                   f32_is_zon2, f32_addsubmul_post);
+}
+
+void float32_sub_batch(float32 *d, const float32 *a, const float32 *b,
+                       size_t n, float_status *s)
+{
+    float32_batch2(d, a, b, n, s, hard_f32_sub, float32_sub,
+                   f32_is_zon2, f32_addsubmul_post);
+}
+
+void float32_mul_batch(float32 *d, const float32 *a, const float32 *b,
+                       size_t n, float_status *s)
+{
+    float32_batch2(d, a, b, n, s, hard_f32_mul, float32_mul,
+                   f32_is_zon2, f32_addsubmul_post);
+}
+
+void float32_div_batch(float32 *d, const float32 *a, const float32 *b,
+                       size_t n, float_status *s)
+{
+    float32_batch2(d, a, b, n, s, hard_f32_div, float32_div,
+                   f32_div_pre, f32_div_post);
+}
+
+void float64_add_batch(float64 *d, const float64 *a, const float64 *b,
+                       size_t n, float_status *s)
+{
+    float64_batch2(d, a, b, n, s, hard_f64_add, float64_add,
+                   f64_is_zon2, f64_addsubmul_post);
+}
+
+void float64_sub_batch(float64 *d, const float64 *a, const float64 *b,
+                       size_t n, float_status *s)
+{
+    float64_batch2(d, a, b, n, s, hard_f64_sub, float64_sub,
+                   f64_is_zon2, f64_addsubmul_post);
+}
+
+void float64_mul_batch(float64 *d, const float64 *a, const float64 *b,
+                       size_t n, float_status *s)
+{
+    float64_batch2(d, a, b, n, s, hard_f64_mul, float64_mul,
+                   f64_is_zon2, f64_addsubmul_post);
+}
+
+void float64_div_batch(float64 *d, const float64 *a, const float64 *b,
+                       size_t n, float_status *s)
+{
+    float64_batch2(d, a, b, n, s, hard_f64_div, float64_div,
+                   f64_div_pre, f64_div_post);
+}
+
+/*
+ * As for float32_muladd, lanes with a zero product are left to the scalar
+ * function to get the sign of a zero result right.
+ */
+void float32_muladd_batch(float32 *d, const float32 *a, const float32 *b,
+                          const float32 *c, size_t n, float_status *s)
+{
+    while (n) {
+        size_t i, len = MIN(n, SOFTFLOAT_BATCH);
+        union_float32 r[SOFTFLOAT_BATCH];
+        bool redo[SOFTFLOAT_BATCH];
+        bool any_redo = false;
+
+        if (unlikely(!can_use_fpu(s) || force_soft_fma)) {
+            for (i = 0; i < len; i++) {
+                r[i].s = float32_muladd(a[i], b[i], c[i], 0, s);
+            }
+        } else {
+            for (i = 0; i < len; i++) {
+                union_float32 ua = { .s = a[i] }, ub = { .s = b[i] };
+                union_float32 uc = { .s = c[i] };
+
+                r[i].h = fmaf(ua.h, ub.h, uc.h);
+                redo[i] = !f32_is_zon3(ua, ub, uc) ||
+                          float32_is_zero(ua.s) || float32_is_zero(ub.s) ||
+                          f32_is_inf(r[i]) || fabsf(r[i].h) <= FLT_MIN;
+                any_redo |= redo[i];
+            }
+            if (unlikely(any_redo)) {
+                for (i = 0; i < len; i++) {
+                    if (redo[i]) {
+                        r[i].s = float32_muladd(a[i], b[i], c[i], 0, s);
+                    }
+                }
+            }
+        }
+
+        memcpy(d, r, len * sizeof(*d));
+        d += len;
+        a += len;
+        b += len;
+        c += len;
+        n -= len;
+    }
+}
+
+void float64_muladd_batch(float64 *d, const float64 *a, const float64 *b,
+                          const float64 *c, size_t n, float_status *s)
+{
+    while (n) {
+        size_t i, len = MIN(n, SOFTFLOAT_BATCH);
+        union_float64 r[SOFTFLOAT_BATCH];
+        bool redo[SOFTFLOAT_BATCH];
+        bool any_redo = false;
+
+        if (unlikely(!can_use_fpu(s) || force_soft_fma)) {
+            for (i = 0; i < len; i++) {
+                r[i].s = float64_muladd(a[i], b[i], c[i], 0, s);
+            }
+        } else {
+            for (i = 0; i < len; i++) {
+                union_float64 ua = { .s = a[i] }, ub = { .s = b[i] };
+                union_float64 uc = { .s = c[i] };
+
+                r[i].h = fma(ua.h, ub.h, uc.h);
+                redo[i] = !f64_is_zon3(ua, ub, uc) ||
+                          float64_is_zero(ua.s) || float64_is_zero(ub.s) ||
+                          f64_is_inf(r[i]) || fabs(r[i].h) <= DBL_MIN;
+                any_redo |= redo[i];
+            }
+            if (unlikely(any_redo)) {
+                for (i = 0; i < len; i++) {
+                    if (redo[i]) {
+                        r[i].s = float64_muladd(a[i], b[i], c[i], 0, s);
+                    }
+                }
+            }
+        }
+
+        memcpy(d, r, len * sizeof(*d));
+        d += len;
+        a += len;
+        b += len;
+        c += len;
+        n -= len;
+    }
+}
+
 /*
  * Square Root
  */
 
-float16 QEMU_FLATTEN float16_sqrt(float16 a, float_status *status)
+static float16 QEMU_SOFTFLOAT_ATTR
+soft_f16_sqrt(float16 a, float_status *status)
 {
     FloatParts64 p;
 
@@ -4681,6 +5200,27 @@ float16 QEMU_FLATTEN float16_sqrt(float16 a, float_status *status)
     return float16_round_pack_canonical(&p, status);
 }
 
+float16 QEMU_FLATTEN float16_sqrt(float16 a, float_status *s)
+{
+    union_float32 ua, ur;
+    float16 r;
+
+    if (unlikely(!can_use_fpu(s)) ||
+        unlikely(!float16_is_zero_or_normal(a) || float16_is_neg(a))) {
+        goto soft;
+    }
+
+    ua.s = f16_widen(a);
+    ur.h = sqrtf(ua.h);
+    if (unlikely(!f16_narrow(ur.s, &r, s))) {
+        goto soft;
+    }
+    return r;
+
+ soft:
+    return soft_f16_sqrt(a, s);
+}
+
 static float32 QEMU_SOFTFLOAT_ATTR
 soft_f32_sqrt(float32 a, float_status *status)
 {
@@ -4764,7 +5304,8 @@ float64 float64r32_sqrt(float64 a, float_status *status)
     return float64r32_round_pack_canonical(&p, status);
 }
 
-bfloat16 QEMU_FLATTEN bfloat16_sqrt(bfloat16 a, float_status *status)
+static bfloat16 QEMU_SOFTFLOAT_ATTR
+soft_bf16_sqrt(bfloat16 a, float_status *status)
 {
     FloatParts64 p;
 
@@ -4773,6 +5314,27 @@ bfloat16 QEMU_FLATTEN bfloat16_sqrt(bfloat16 a, float_status *status)
     return bfloat16_round_pack_canonical(&p, status);
 }
 
+bfloat16 QEMU_FLATTEN bfloat16_sqrt(bfloat16 a, float_status *s)
+{
+    union_float32 ua, ur;
+    bfloat16 r;
+
+    if (unlikely(!can_use_fpu(s)) ||
+        unlikely(!bfloat16_is_zero_or_normal(a) || bfloat16_is_neg(a))) {
+        goto soft;
+    }
+
+    ua.s = bf16_widen(a);
+    ur.h = sqrtf(ua.h);
+    if (unlikely(!bf16_narrow(ur.s, &r, s))) {
+        goto soft;
+    }
+    return r;
+
+ soft:
+    return soft_bf16_sqrt(a, s);
+}
+
 float128 QEMU_FLATTEN float128_sqrt(float128 a, float_status *status)
 {
     FloatParts128 p;
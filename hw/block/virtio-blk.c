@@ -89,7 +89,7 @@ static int virtio_blk_handle_rw_error(VirtIOBlockReq *req, int error,
         if (acct_failed) {
             block_acct_failed(blk_get_stats(s->blk), &req->acct);
         }
-        g_free(req);
+        virtqueue_recycle_element(req->vq, req);
     }
 
     blk_error_action(s->blk, action, is_read, error);
@@ -132,7 +132,7 @@ static void virtio_blk_rw_complete(void *opaque, int ret)
 
         virtio_blk_req_complete(req, VIRTIO_BLK_S_OK);
         block_acct_done(blk_get_stats(s->blk), &req->acct);
-        g_free(req);
+        virtqueue_recycle_element(req->vq, req);
     }
 }
 
@@ -147,7 +147,7 @@ static void virtio_blk_flush_complete(void *opaque, int ret)
 
     virtio_blk_req_complete(req, VIRTIO_BLK_S_OK);
     block_acct_done(blk_get_stats(s->blk), &req->acct);
-    g_free(req);
+    virtqueue_recycle_element(req->vq, req);
 }
 
 static void virtio_blk_discard_write_zeroes_complete(void *opaque, int ret)
@@ -165,17 +165,7 @@ static void virtio_blk_discard_write_zeroes_complete(void *opaque, int ret)
     if (is_write_zeroes) {
         block_acct_done(blk_get_stats(s->blk), &req->acct);
     }
-    g_free(req);
-}
-
-static VirtIOBlockReq *virtio_blk_get_request(VirtIOBlock *s, VirtQueue *vq)
-{
-    VirtIOBlockReq *req = virtqueue_pop(vq, sizeof(VirtIOBlockReq));
-
-    if (req) {
-        virtio_blk_init_request(s, vq, req);
-    }
-    return req;
+    virtqueue_recycle_element(req->vq, req);
 }
 
 static void virtio_blk_handle_scsi(VirtIOBlockReq *req)
@@ -978,11 +968,16 @@ static int virtio_blk_handle_request(VirtIOBlockReq *req, MultiReqBuffer *mrb)
     return 0;
 }
 
+/* Maximum number of requests taken from the virtqueue at once */
+#define VIRTIO_BLK_POP_BATCH 32
+
 void virtio_blk_handle_vq(VirtIOBlock *s, VirtQueue *vq)
 {
-    VirtIOBlockReq *req;
+    VirtIOBlockReq *reqs[VIRTIO_BLK_POP_BATCH];
     MultiReqBuffer mrb = {};
     bool suppress_notifications = virtio_queue_get_notification(vq);
+    bool failed = false;
+    unsigned int i, n;
 
     defer_call_begin();
 
@@ -991,11 +986,23 @@ void virtio_blk_handle_vq(VirtIOBlock *s, VirtQueue *vq)
             virtio_queue_set_notification(vq, 0);
         }
 
-        while ((req = virtio_blk_get_request(s, vq))) {
-            if (virtio_blk_handle_request(req, &mrb)) {
-                virtqueue_detach_element(req->vq, &req->elem, 0);
-                g_free(req);
-                break;
+        while (!failed &&
+               (n = virtqueue_pop_batch(vq, sizeof(VirtIOBlockReq),
+                                        (void **)reqs, ARRAY_SIZE(reqs)))) {
+            for (i = 0; i < n; i++) {
+                if (failed) {
+                    /* The device is broken, drop the rest of the batch */
+                    virtqueue_detach_element(vq, &reqs[i]->elem, 0);
+                    g_free(reqs[i]);
+                    continue;
+                }
+
+                virtio_blk_init_request(s, vq, reqs[i]);
+                if (virtio_blk_handle_request(reqs[i], &mrb)) {
+                    virtqueue_detach_element(vq, &reqs[i]->elem, 0);
+                    g_free(reqs[i]);
+                    failed = true;
+                }
             }
         }
 
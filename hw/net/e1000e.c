@@ -216,6 +216,13 @@ e1000e_nc_receive_iov(NetClientState *nc, const struct iovec *iov, int iovcnt)
     return e1000e_receive_iov(&s->core, iov, iovcnt);
 }
 
+static int
+e1000e_nc_receive_batch(NetClientState *nc, const NetPacketVec *pkts, int npkts)
+{
+    E1000EState *s = qemu_get_nic_opaque(nc);
+    return e1000e_receive_batch(&s->core, pkts, npkts);
+}
+
 static ssize_t
 e1000e_nc_receive(NetClientState *nc, const uint8_t *buf, size_t size)
 {
@@ -236,6 +243,7 @@ static NetClientInfo net_e1000e_info = {
     .can_receive = e1000e_nc_can_receive,
     .receive = e1000e_nc_receive,
     .receive_iov = e1000e_nc_receive_iov,
+    .receive_batch = e1000e_nc_receive_batch,
     .link_status_changed = e1000e_set_link_status,
 };
 
@@ -671,6 +679,7 @@ static const Property e1000e_properties[] = {
                         e1000e_prop_subsys, uint16_t),
     DEFINE_PROP_BOOL("init-vet", E1000EState, init_vet, true),
     DEFINE_PROP_BOOL("migrate-timadj", E1000EState, timadj, true),
+    DEFINE_PROP_BOOL("adaptive-itr", E1000EState, core.adaptive_itr, true),
 };
 
 static void e1000e_class_init(ObjectClass *class, const void *data)
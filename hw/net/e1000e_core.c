@@ -54,6 +54,12 @@
 /* No more then 7813 interrupts per second according to spec 10.2.4.2 */
 #define E1000E_MIN_XITR     (500)
 
+/*
+ * Adaptive moderation never throttles below ~3900 interrupts per second,
+ * the rate Linux e1000e settles on for bulk traffic.
+ */
+#define E1000E_MAX_ADAPTIVE_XITR    (1000)
+
 #define E1000E_MAX_TX_FRAGS (64)
 
 union e1000_rx_desc_union {
@@ -150,12 +156,39 @@ e1000e_intrmgr_on_timer(void *opaque)
     e1000e_intrmgr_fire_delayed_interrupts(timer->core);
 }
 
+/*
+ * With [E]ITR left at zero by the guest, double the throttling interval
+ * while more than one interrupt per interval gets coalesced and halve it
+ * once an interval passes without any, NAPI style.
+ */
+static void
+e1000e_intrmgr_adapt_xitr(E1000IntrDelayTimer *timer, uint32_t guest_value)
+{
+    uint32_t *xitr = &timer->core->mac[timer->delay_reg];
+    uint32_t postponed = timer->postponed;
+
+    timer->postponed = 0;
+
+    if (!timer->core->adaptive_itr || guest_value) {
+        return;
+    }
+
+    if (postponed > 1) {
+        *xitr = MIN(*xitr * 2, E1000E_MAX_ADAPTIVE_XITR);
+    } else if (!postponed) {
+        *xitr = MAX(*xitr / 2, E1000E_MIN_XITR);
+    }
+
+    trace_e1000e_irq_adapt_xitr(timer->delay_reg << 2, postponed, *xitr);
+}
+
 static void
 e1000e_intrmgr_on_throttling_timer(void *opaque)
 {
     E1000IntrDelayTimer *timer = opaque;
 
     timer->running = false;
+    e1000e_intrmgr_adapt_xitr(timer, timer->core->itr_guest_value);
 
     if (timer->core->mac[IMS] & timer->core->mac[ICR]) {
         if (msi_enabled(timer->core->owner)) {
@@ -175,6 +208,7 @@ e1000e_intrmgr_on_msix_throttling_timer(void *opaque)
     int idx = timer - &timer->core->eitr[0];
 
     timer->running = false;
+    e1000e_intrmgr_adapt_xitr(timer, timer->core->eitr_guest_value[idx]);
 
     trace_e1000e_irq_msix_notify_postponed_vec(idx);
     msix_notify(timer->core->owner, idx);
@@ -1623,11 +1657,25 @@ e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt)
     return e1000e_receive_internal(core, iov, iovcnt, core->has_vnet);
 }
 
+static void
+e1000e_rx_set_interrupt_cause(E1000ECore *core, uint32_t causes)
+{
+    if (!e1000e_intrmgr_delay_rx_causes(core, &causes)) {
+        trace_e1000e_rx_interrupt_set(causes);
+        e1000e_set_interrupt_cause(core, causes);
+    } else {
+        trace_e1000e_rx_interrupt_delayed(causes);
+    }
+}
+
+/*
+ * Write one frame to the guest, accumulating the interrupt causes it
+ * raises in @causes.  @notify is set once the causes need evaluating.
+ */
 static ssize_t
-e1000e_receive_internal(E1000ECore *core, const struct iovec *iov, int iovcnt,
-                        bool has_vnet)
+e1000e_receive_frame(E1000ECore *core, const struct iovec *iov, int iovcnt,
+                     bool has_vnet, uint32_t *causes, bool *notify)
 {
-    uint32_t causes = 0;
     uint8_t buf[ETH_ZLEN];
     struct iovec min_iov;
     size_t size, orig_size;
@@ -1701,37 +1749,76 @@ e1000e_receive_internal(E1000ECore *core, const struct iovec *iov, int iovcnt,
 
         /* Perform small receive detection (RSRPD) */
         if (total_size < core->mac[RSRPD]) {
-            causes |= E1000_ICS_SRPD;
+            *causes |= E1000_ICS_SRPD;
         }
 
         /* Perform ACK receive detection */
         if  (!(core->mac[RFCTL] & E1000_RFCTL_ACK_DIS) &&
              (e1000e_is_tcp_ack(core, core->rx_pkt))) {
-            causes |= E1000_ICS_ACK;
+            *causes |= E1000_ICS_ACK;
         }
 
         /* Check if receive descriptor minimum threshold hit */
         rdmts_hit = e1000e_rx_descr_threshold_hit(core, rxr.i);
-        causes |= e1000e_rx_wb_interrupt_cause(core, rxr.i->idx, rdmts_hit);
+        *causes |= e1000e_rx_wb_interrupt_cause(core, rxr.i->idx, rdmts_hit);
 
         trace_e1000e_rx_written_to_guest(rxr.i->idx);
     } else {
-        causes |= E1000_ICS_RXO;
+        *causes |= E1000_ICS_RXO;
         retval = 0;
 
         trace_e1000e_rx_not_written_to_guest(rxr.i->idx);
     }
 
-    if (!e1000e_intrmgr_delay_rx_causes(core, &causes)) {
-        trace_e1000e_rx_interrupt_set(causes);
-        e1000e_set_interrupt_cause(core, causes);
-    } else {
-        trace_e1000e_rx_interrupt_delayed(causes);
+    *notify = true;
+
+    return retval;
+}
+
+static ssize_t
+e1000e_receive_internal(E1000ECore *core, const struct iovec *iov, int iovcnt,
+                        bool has_vnet)
+{
+    uint32_t causes = 0;
+    bool notify = false;
+    ssize_t retval;
+
+    retval = e1000e_receive_frame(core, iov, iovcnt, has_vnet,
+                                  &causes, &notify);
+    if (notify) {
+        e1000e_rx_set_interrupt_cause(core, causes);
     }
 
     return retval;
 }
 
+int
+e1000e_receive_batch(E1000ECore *core, const NetPacketVec *pkts, int npkts)
+{
+    uint32_t causes = 0;
+    bool notify = false;
+    int i;
+
+    trace_e1000e_rx_receive_batch(npkts);
+
+    /*
+     * Fill the descriptor rings with the whole batch and evaluate the
+     * interrupt causes once, instead of once per frame.
+     */
+    for (i = 0; i < npkts; i++) {
+        if (e1000e_receive_frame(core, pkts[i].iov, pkts[i].iovcnt,
+                                 core->has_vnet, &causes, &notify) == 0) {
+            break;
+        }
+    }
+
+    if (notify) {
+        e1000e_rx_set_interrupt_cause(core, causes);
+    }
+
+    return i;
+}
+
 static inline bool
 e1000e_have_autoneg(E1000ECore *core)
 {
@@ -1951,6 +2038,7 @@ e1000e_postpone_interrupt(E1000IntrDelayTimer *timer)
 {
     if (timer->running) {
         trace_e1000e_irq_postponed_by_xitr(timer->delay_reg << 2);
+        timer->postponed++;
 
         return true;
     }
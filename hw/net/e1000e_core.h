@@ -55,6 +55,8 @@ typedef struct E1000IntrDelayTimer_st {
     bool running;
     uint32_t delay_reg;
     uint32_t delay_resolution_ns;
+    /* Interrupts held back while the timer was running */
+    uint32_t postponed;
     E1000ECore *core;
 } E1000IntrDelayTimer;
 
@@ -101,6 +103,9 @@ struct E1000Core {
     uint32_t itr_guest_value;
     uint32_t eitr_guest_value[E1000E_MSIX_VEC_NUM];
 
+    /* Scale [E]ITR with the interrupt load when the guest leaves it at 0 */
+    bool adaptive_itr;
+
     uint16_t vet;
 
     uint8_t permanent_mac[ETH_ALEN];
@@ -148,6 +153,9 @@ e1000e_receive(E1000ECore *core, const uint8_t *buf, size_t size);
 ssize_t
 e1000e_receive_iov(E1000ECore *core, const struct iovec *iov, int iovcnt);
 
+int
+e1000e_receive_batch(E1000ECore *core, const NetPacketVec *pkts, int npkts);
+
 void
 e1000e_start_recv(E1000ECore *core);
 
@@ -235,6 +235,13 @@ igb_nc_receive_iov(NetClientState *nc, const struct iovec *iov, int iovcnt)
     return igb_receive_iov(&s->core, iov, iovcnt);
 }
 
+static int
+igb_nc_receive_batch(NetClientState *nc, const NetPacketVec *pkts, int npkts)
+{
+    IGBState *s = qemu_get_nic_opaque(nc);
+    return igb_receive_batch(&s->core, pkts, npkts);
+}
+
 static ssize_t
 igb_nc_receive(NetClientState *nc, const uint8_t *buf, size_t size)
 {
@@ -255,6 +262,7 @@ static NetClientInfo net_igb_info = {
     .can_receive = igb_nc_can_receive,
     .receive = igb_nc_receive,
     .receive_iov = igb_nc_receive_iov,
+    .receive_batch = igb_nc_receive_batch,
     .link_status_changed = igb_set_link_status,
 };
 
@@ -597,6 +605,7 @@ static const VMStateDescription igb_vmstate = {
 static const Property igb_properties[] = {
     DEFINE_NIC_PROPERTIES(IGBState, conf),
     DEFINE_PROP_BOOL("x-pcie-flr-init", IGBState, has_flr, true),
+    DEFINE_PROP_BOOL("adaptive-itr", IGBState, core.adaptive_itr, true),
 };
 
 static void igb_class_init(ObjectClass *class, const void *data)
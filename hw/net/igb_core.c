@@ -90,6 +90,13 @@ typedef struct PTP2 {
     uint8_t log_message_period;
 } PTP2;
 
+/*
+ * Bounds for adaptive moderation, in EITR units: start throttling above
+ * ~20000 interrupts per second and never go below ~4000.
+ */
+#define IGB_MIN_ADAPTIVE_EITR   (48)
+#define IGB_MAX_ADAPTIVE_EITR   (244)
+
 static ssize_t
 igb_receive_internal(IGBCore *core, const struct iovec *iov, int iovcnt,
                      bool has_vnet, bool *external_tx);
@@ -160,6 +167,39 @@ igb_intmgr_timer_resume(IGBIntrDelayTimer *timer)
     }
 }
 
+static inline bool
+igb_eitr_adaptive(IGBCore *core, int idx)
+{
+    return core->adaptive_itr && !(core->eitr_guest_value[idx] & 0x7FFE);
+}
+
+/*
+ * With EITR left at zero by the guest, double the throttling interval
+ * while more than one interrupt per interval gets coalesced and halve it
+ * once an interval passes without any, NAPI style.  Below the minimum
+ * the vector goes back to unthrottled operation.
+ */
+static void
+igb_intrmgr_adapt_eitr(IGBIntrDelayTimer *timer, int idx)
+{
+    uint32_t *eitr = &timer->core->mac[timer->delay_reg];
+    uint32_t postponed = timer->postponed;
+
+    timer->postponed = 0;
+
+    if (!igb_eitr_adaptive(timer->core, idx)) {
+        return;
+    }
+
+    if (postponed > 1) {
+        *eitr = MIN(*eitr * 2, IGB_MAX_ADAPTIVE_EITR);
+    } else if (!postponed) {
+        *eitr = *eitr / 2 >= IGB_MIN_ADAPTIVE_EITR ? *eitr / 2 : 0;
+    }
+
+    trace_e1000e_irq_adapt_xitr(timer->delay_reg << 2, postponed, *eitr);
+}
+
 static void
 igb_intrmgr_on_msix_throttling_timer(void *opaque)
 {
@@ -167,6 +207,7 @@ igb_intrmgr_on_msix_throttling_timer(void *opaque)
     int idx = timer - &timer->core->eitr[0];
 
     timer->running = false;
+    igb_intrmgr_adapt_eitr(timer, idx);
 
     trace_e1000e_irq_msix_notify_postponed_vec(idx);
     igb_msix_notify(timer->core, idx);
@@ -1981,13 +2022,17 @@ igb_receive_iov(IGBCore *core, const struct iovec *iov, int iovcnt)
     return igb_receive_internal(core, iov, iovcnt, core->has_vnet, NULL);
 }
 
+/*
+ * Write one frame to the guest, accumulating the interrupt causes it
+ * raises in @causes and @ecauses.  @notify is set once the causes need
+ * raising.
+ */
 static ssize_t
-igb_receive_internal(IGBCore *core, const struct iovec *iov, int iovcnt,
-                     bool has_vnet, bool *external_tx)
+igb_receive_frame(IGBCore *core, const struct iovec *iov, int iovcnt,
+                  bool has_vnet, bool *external_tx,
+                  uint32_t *causes, uint32_t *ecauses, bool *notify)
 {
     uint16_t queues = 0;
-    uint32_t causes = 0;
-    uint32_t ecauses = 0;
     union {
         L2Header l2_header;
         uint8_t octets[ETH_ZLEN];
@@ -2075,31 +2120,81 @@ igb_receive_internal(IGBCore *core, const struct iovec *iov, int iovcnt,
             e1000x_fcs_len(core->mac);
 
         if (!igb_has_rxbufs(core, rxr.i, total_size)) {
-            causes |= E1000_ICS_RXO;
+            *causes |= E1000_ICS_RXO;
             trace_e1000e_rx_not_written_to_guest(rxr.i->idx);
             continue;
         }
 
-        causes |= E1000_ICR_RXDW;
+        *causes |= E1000_ICR_RXDW;
 
         igb_rx_fix_l4_csum(core, core->rx_pkt);
         igb_write_packet_to_guest(core, core->rx_pkt, &rxr, &rss_info, etqf, ts);
 
         /* Check if receive descriptor minimum threshold hit */
         if (igb_rx_descr_threshold_hit(core, rxr.i)) {
-            causes |= E1000_ICS_RXDMT0;
+            *causes |= E1000_ICS_RXDMT0;
         }
 
-        ecauses |= igb_rx_wb_eic(core, rxr.i->idx);
+        *ecauses |= igb_rx_wb_eic(core, rxr.i->idx);
 
         trace_e1000e_rx_written_to_guest(rxr.i->idx);
     }
 
+    *notify = true;
+
+    return orig_size;
+}
+
+static void
+igb_rx_raise_interrupts(IGBCore *core, uint32_t causes, uint32_t ecauses)
+{
     trace_e1000e_rx_interrupt_set(causes);
     igb_raise_interrupts(core, EICR, ecauses);
     igb_raise_interrupts(core, ICR, causes);
+}
 
-    return orig_size;
+static ssize_t
+igb_receive_internal(IGBCore *core, const struct iovec *iov, int iovcnt,
+                     bool has_vnet, bool *external_tx)
+{
+    uint32_t causes = 0;
+    uint32_t ecauses = 0;
+    bool notify = false;
+    ssize_t retval;
+
+    retval = igb_receive_frame(core, iov, iovcnt, has_vnet, external_tx,
+                               &causes, &ecauses, &notify);
+    if (notify) {
+        igb_rx_raise_interrupts(core, causes, ecauses);
+    }
+
+    return retval;
+}
+
+int
+igb_receive_batch(IGBCore *core, const NetPacketVec *pkts, int npkts)
+{
+    uint32_t causes = 0;
+    uint32_t ecauses = 0;
+    bool notify = false;
+    int i;
+
+    trace_e1000e_rx_receive_batch(npkts);
+
+    /*
+     * Fill the descriptor rings with the whole batch and raise the
+     * interrupt causes once, instead of once per frame.
+     */
+    for (i = 0; i < npkts; i++) {
+        igb_receive_frame(core, pkts[i].iov, pkts[i].iovcnt, core->has_vnet,
+                          NULL, &causes, &ecauses, &notify);
+    }
+
+    if (notify) {
+        igb_rx_raise_interrupts(core, causes, ecauses);
+    }
+
+    return i;
 }
 
 static inline bool
@@ -2240,12 +2335,27 @@ igb_set_rx_control(IGBCore *core, int index, uint32_t val)
 static inline bool
 igb_postpone_interrupt(IGBIntrDelayTimer *timer)
 {
+    int idx = timer - &timer->core->eitr[0];
+    int64_t now;
+
     if (timer->running) {
         trace_e1000e_irq_postponed_by_xitr(timer->delay_reg << 2);
+        timer->postponed++;
 
         return true;
     }
 
+    if (timer->core->mac[timer->delay_reg] == 0 &&
+        igb_eitr_adaptive(timer->core, idx)) {
+        /* Start throttling once interrupts come faster than the minimum */
+        now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+        if (now - timer->last_notify_ns <
+            (int64_t)IGB_MIN_ADAPTIVE_EITR * timer->delay_resolution_ns) {
+            timer->core->mac[timer->delay_reg] = IGB_MIN_ADAPTIVE_EITR;
+        }
+        timer->last_notify_ns = now;
+    }
+
     if (timer->core->mac[timer->delay_reg] != 0) {
         igb_intrmgr_rearm_timer(timer);
     }
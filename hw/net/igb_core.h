@@ -60,6 +60,10 @@ typedef struct IGBIntrDelayTimer_st {
     bool running;
     uint32_t delay_reg;
     uint32_t delay_resolution_ns;
+    /* Interrupts held back while the timer was running */
+    uint32_t postponed;
+    /* Time of the last interrupt sent without throttling */
+    int64_t last_notify_ns;
     IGBCore *core;
 } IGBIntrDelayTimer;
 
@@ -92,6 +96,9 @@ struct IGBCore {
 
     uint32_t eitr_guest_value[IGB_INTR_NUM];
 
+    /* Scale EITR with the interrupt load when the guest leaves it at 0 */
+    bool adaptive_itr;
+
     uint8_t permanent_mac[ETH_ALEN];
 
     NICState *owner_nic;
@@ -140,6 +147,9 @@ igb_receive(IGBCore *core, const uint8_t *buf, size_t size);
 ssize_t
 igb_receive_iov(IGBCore *core, const struct iovec *iov, int iovcnt);
 
+int
+igb_receive_batch(IGBCore *core, const NetPacketVec *pkts, int npkts);
+
 void
 igb_start_recv(IGBCore *core);
 
@@ -307,8 +307,7 @@ net_rx_pkt_calc_rss_hash(struct NetRxPkt *pkt,
 {
     uint8_t rss_input[36];
     size_t rss_length = 0;
-    uint32_t rss_hash = 0;
-    net_toeplitz_key key_data;
+    uint32_t rss_hash;
 
     switch (type) {
     case NetPktRssIpV4:
@@ -372,8 +371,7 @@ net_rx_pkt_calc_rss_hash(struct NetRxPkt *pkt,
         g_assert_not_reached();
     }
 
-    net_toeplitz_key_init(&key_data, key);
-    net_toeplitz_add(&rss_hash, rss_input, rss_length, &key_data);
+    rss_hash = net_toeplitz_hash(key, rss_input, rss_length);
 
     trace_net_rx_pkt_rss_hash(rss_length, rss_hash);
 
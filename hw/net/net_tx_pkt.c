@@ -50,6 +50,11 @@ struct NetTxPkt {
         struct ip6_header ip6;
         uint8_t octets[ETH_MAX_IP_DGRAM_LEN];
     } l3_hdr;
+    /* TCP header rewritten for every segment of software TSO */
+    union {
+        struct tcp_hdr tcp;
+        uint8_t octets[0xf * sizeof(uint32_t)];
+    } l4_hdr;
 
     uint32_t payload_len;
 
@@ -588,7 +593,6 @@ static void net_tx_pkt_sendv(
 static bool net_tx_pkt_tcp_fragment_init(struct NetTxPkt *pkt,
                                          struct iovec *fragment,
                                          int *pl_idx,
-                                         size_t *l4hdr_len,
                                          int *src_idx,
                                          size_t *src_offset,
                                          size_t *src_len)
@@ -602,7 +606,11 @@ static bool net_tx_pkt_tcp_fragment_init(struct NetTxPkt *pkt,
     }
 
     l4->iov_len = pkt->virt_hdr.hdr_len - pkt->hdr_len;
-    l4->iov_base = g_malloc(l4->iov_len);
+    if (l4->iov_len < sizeof(struct tcp_hdr) ||
+        l4->iov_len > sizeof(pkt->l4_hdr)) {
+        return false;
+    }
+    l4->iov_base = &pkt->l4_hdr;
 
     *src_idx = NET_TX_PKT_PL_START_FRAG;
     while (pkt->vec[*src_idx].iov_len < l4->iov_len - bytes_read) {
@@ -613,7 +621,6 @@ static bool net_tx_pkt_tcp_fragment_init(struct NetTxPkt *pkt,
 
         (*src_idx)++;
         if (*src_idx >= pkt->payload_frags + NET_TX_PKT_PL_START_FRAG) {
-            g_free(l4->iov_base);
             return false;
         }
     }
@@ -626,17 +633,11 @@ static bool net_tx_pkt_tcp_fragment_init(struct NetTxPkt *pkt,
     th->th_flags &= ~(TH_FIN | TH_PUSH);
 
     *pl_idx = NET_TX_PKT_PL_START_FRAG + 1;
-    *l4hdr_len = l4->iov_len;
     *src_len = pkt->virt_hdr.gso_size;
 
     return true;
 }
 
-static void net_tx_pkt_tcp_fragment_deinit(struct iovec *fragment)
-{
-    g_free(fragment[NET_TX_PKT_PL_START_FRAG].iov_base);
-}
-
 static void net_tx_pkt_tcp_fragment_fix(struct NetTxPkt *pkt,
                                         struct iovec *fragment,
                                         size_t fragment_len,
@@ -661,6 +662,41 @@ static void net_tx_pkt_tcp_fragment_fix(struct NetTxPkt *pkt,
     }
 }
 
+/*
+ * Checksum one segment straight from the header copies and the payload
+ * fragments it references, without going through the generic iovec
+ * helpers that look up the L3 protocol and checksum field again.
+ */
+static void net_tx_pkt_tcp_fragment_csum(struct NetTxPkt *pkt,
+                                         struct iovec *fragment,
+                                         int dst_idx,
+                                         size_t fragment_len,
+                                         uint8_t gso_type)
+{
+    struct iovec *l3hdr = fragment + NET_TX_PKT_L3HDR_FRAG;
+    struct iovec *l4hdr = fragment + NET_TX_PKT_PL_START_FRAG;
+    struct tcp_hdr *th = l4hdr->iov_base;
+    uint32_t csl = l4hdr->iov_len + fragment_len;
+    uint32_t csum_cntr;
+    uint32_t cso;
+
+    th->th_sum = 0;
+
+    if (gso_type == VIRTIO_NET_HDR_GSO_TCPV4) {
+        csum_cntr = eth_calc_ip4_pseudo_hdr_csum(l3hdr->iov_base, csl, &cso);
+    } else {
+        csum_cntr = eth_calc_ip6_pseudo_hdr_csum(l3hdr->iov_base, csl,
+                                                 pkt->l4proto, &cso);
+    }
+
+    csum_cntr += net_checksum_add_cont(l4hdr->iov_len, l4hdr->iov_base, cso);
+    csum_cntr += net_checksum_add_iov(l4hdr + 1,
+                                      dst_idx - NET_TX_PKT_PL_START_FRAG - 1,
+                                      0, fragment_len, cso + l4hdr->iov_len);
+
+    th->th_sum = cpu_to_be16(net_checksum_finish_nozero(csum_cntr));
+}
+
 static void net_tx_pkt_tcp_fragment_advance(struct NetTxPkt *pkt,
                                             struct iovec *fragment,
                                             size_t fragment_len,
@@ -681,12 +717,10 @@ static void net_tx_pkt_tcp_fragment_advance(struct NetTxPkt *pkt,
 
 static void net_tx_pkt_udp_fragment_init(struct NetTxPkt *pkt,
                                          int *pl_idx,
-                                         size_t *l4hdr_len,
                                          int *src_idx, size_t *src_offset,
                                          size_t *src_len)
 {
     *pl_idx = NET_TX_PKT_PL_START_FRAG;
-    *l4hdr_len = 0;
     *src_idx = NET_TX_PKT_PL_START_FRAG;
     *src_offset = 0;
     *src_len = IP_FRAG_ALIGN_SIZE(pkt->virt_hdr.gso_size);
@@ -723,7 +757,6 @@ static bool net_tx_pkt_do_sw_fragmentation(struct NetTxPkt *pkt,
 
     struct iovec fragment[NET_MAX_FRAG_SG_LIST];
     size_t fragment_len;
-    size_t l4hdr_len;
     size_t src_len;
 
     int src_idx, dst_idx, pl_idx;
@@ -743,7 +776,7 @@ static bool net_tx_pkt_do_sw_fragmentation(struct NetTxPkt *pkt,
     switch (gso_type) {
     case VIRTIO_NET_HDR_GSO_TCPV4:
     case VIRTIO_NET_HDR_GSO_TCPV6:
-        if (!net_tx_pkt_tcp_fragment_init(pkt, fragment, &pl_idx, &l4hdr_len,
+        if (!net_tx_pkt_tcp_fragment_init(pkt, fragment, &pl_idx,
                                           &src_idx, &src_offset, &src_len)) {
             return false;
         }
@@ -753,7 +786,7 @@ static bool net_tx_pkt_do_sw_fragmentation(struct NetTxPkt *pkt,
         net_tx_pkt_do_sw_csum(pkt, &pkt->vec[NET_TX_PKT_L2HDR_FRAG],
                               pkt->payload_frags + NET_TX_PKT_PL_START_FRAG - 1,
                               pkt->payload_len);
-        net_tx_pkt_udp_fragment_init(pkt, &pl_idx, &l4hdr_len,
+        net_tx_pkt_udp_fragment_init(pkt, &pl_idx,
                                      &src_idx, &src_offset, &src_len);
         break;
 
@@ -774,9 +807,8 @@ static bool net_tx_pkt_do_sw_fragmentation(struct NetTxPkt *pkt,
         case VIRTIO_NET_HDR_GSO_TCPV4:
         case VIRTIO_NET_HDR_GSO_TCPV6:
             net_tx_pkt_tcp_fragment_fix(pkt, fragment, fragment_len, gso_type);
-            net_tx_pkt_do_sw_csum(pkt, fragment + NET_TX_PKT_L2HDR_FRAG,
-                                  dst_idx - NET_TX_PKT_L2HDR_FRAG,
-                                  l4hdr_len + fragment_len);
+            net_tx_pkt_tcp_fragment_csum(pkt, fragment, dst_idx,
+                                         fragment_len, gso_type);
             break;
 
         case VIRTIO_NET_HDR_GSO_UDP:
@@ -798,11 +830,6 @@ static bool net_tx_pkt_do_sw_fragmentation(struct NetTxPkt *pkt,
         fragment_offset += fragment_len;
     }
 
-    if (gso_type == VIRTIO_NET_HDR_GSO_TCPV4 ||
-        gso_type == VIRTIO_NET_HDR_GSO_TCPV6) {
-        net_tx_pkt_tcp_fragment_deinit(fragment);
-    }
-
     return true;
 }
 
@@ -63,6 +63,7 @@
 
 #define VIRTIO_NET_TCP_FLAG         0x3F
 #define VIRTIO_NET_TCP_HDR_LENGTH   0xF000
+#define VIRTIO_NET_TCP_PORT_SIZE    4       /* sport + dport */
 
 /* IPv4 max payload, 16 bits in the header */
 #define VIRTIO_NET_MAX_IP4_PAYLOAD (65535 - sizeof(struct ip_header))
@@ -912,6 +913,10 @@ static void virtio_net_set_features(VirtIODevice *vdev, uint64_t features)
         n->curr_guest_offloads =
             virtio_net_guest_offloads_by_features(features);
         virtio_net_apply_guest_offloads(n);
+    } else if (n->rx_gro) {
+        /* Only software GRO looks at these */
+        n->curr_guest_offloads =
+            virtio_net_guest_offloads_by_features(features);
     }
 
     for (i = 0;  i < n->max_queue_pairs; i++) {
@@ -981,6 +986,8 @@ static int virtio_net_handle_rx_mode(VirtIONet *n, uint8_t cmd,
     return VIRTIO_NET_OK;
 }
 
+static void virtio_net_gro_flush(VirtIONet *n, bool flush);
+
 static int virtio_net_handle_offloads(VirtIONet *n, uint8_t cmd,
                                      struct iovec *iov, unsigned int iov_cnt)
 {
@@ -1002,7 +1009,7 @@ static int virtio_net_handle_offloads(VirtIONet *n, uint8_t cmd,
 
         offloads = virtio_ldq_p(vdev, &offloads);
 
-        if (!n->has_vnet_hdr) {
+        if (!n->has_vnet_hdr && !n->rx_gro) {
             return VIRTIO_NET_ERR;
         }
 
@@ -1017,6 +1024,15 @@ static int virtio_net_handle_offloads(VirtIONet *n, uint8_t cmd,
             return VIRTIO_NET_ERR;
         }
 
+        if (!n->has_vnet_hdr) {
+            /* Deliver what GRO holds with the offloads it was built for */
+            WITH_RCU_READ_LOCK_GUARD() {
+                virtio_net_gro_flush(n, true);
+            }
+            n->curr_guest_offloads = offloads;
+            return VIRTIO_NET_OK;
+        }
+
         n->curr_guest_offloads = offloads;
         virtio_net_apply_guest_offloads(n);
 
@@ -1564,6 +1580,10 @@ static void virtio_net_handle_rx(VirtIODevice *vdev, VirtQueue *vq)
     VirtIONet *n = VIRTIO_NET(vdev);
     int queue_index = vq2q(virtio_get_queue_index(vq));
 
+    /* Retry GRO flows that did not fit in the RX buffers */
+    if (!QTAILQ_EMPTY(&n->gro_flows)) {
+        qemu_bh_schedule(n->gro_bh);
+    }
     qemu_flush_queued_packets(qemu_get_subqueue(n->nic, queue_index));
 }
 
@@ -1655,7 +1675,8 @@ static void work_around_broken_dhclient(struct virtio_net_hdr *hdr,
 }
 
 static void receive_header(VirtIONet *n, const struct iovec *iov, int iov_cnt,
-                           const void *buf, size_t size)
+                           const void *buf, size_t size,
+                           const struct virtio_net_hdr *gro_hdr)
 {
     if (n->has_vnet_hdr) {
         /* FIXME this cast is evil */
@@ -1667,6 +1688,8 @@ static void receive_header(VirtIONet *n, const struct iovec *iov, int iov_cnt,
             virtio_net_hdr_swap(VIRTIO_DEVICE(n), wbuf);
         }
         iov_from_buf(iov, iov_cnt, 0, buf, sizeof(struct virtio_net_hdr));
+    } else if (gro_hdr) {
+        iov_from_buf(iov, iov_cnt, 0, gro_hdr, sizeof(*gro_hdr));
     } else {
         struct virtio_net_hdr hdr = {
             .flags = 0,
@@ -1841,8 +1864,24 @@ static int virtio_net_process_rss(NetClientState *nc, const uint8_t *buf,
     return (index == new_index) ? -1 : new_index;
 }
 
+/* Called within rcu_read_lock().  */
+static void virtio_net_flush_rx(VirtIONet *n, VirtIONetQueue *q)
+{
+    if (q->rx_pending) {
+        virtqueue_flush(q->rx_vq, q->rx_pending);
+        virtio_notify(VIRTIO_DEVICE(n), q->rx_vq);
+        q->rx_pending = 0;
+    }
+}
+
+/*
+ * @gro_hdr is the header built by software GRO for a packet from a
+ * backend without vnet header, or NULL.
+ */
 static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
-                                      size_t size)
+                                      size_t size,
+                                      const struct virtio_net_hdr *gro_hdr,
+                                      bool flush)
 {
     VirtIONet *n = qemu_get_nic_opaque(nc);
     VirtIONetQueue *q;
@@ -1929,7 +1968,7 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
                 extra_hdr.hdr.num_buffers = cpu_to_le16(1);
             }
 
-            receive_header(n, sg, elem->in_num, buf, size);
+            receive_header(n, sg, elem->in_num, buf, size, gro_hdr);
             if (n->rss_data.populate_hash) {
                 offset = offsetof(typeof(extra_hdr), hash_value);
                 iov_from_buf(sg, elem->in_num, offset,
@@ -1974,19 +2013,21 @@ static ssize_t virtio_net_receive_rcu(NetClientState *nc, const uint8_t *buf,
 
     for (j = 0; j < i; j++) {
         /* signal other side */
-        virtqueue_fill(q->rx_vq, elems[j], lens[j], j);
-        g_free(elems[j]);
+        virtqueue_fill(q->rx_vq, elems[j], lens[j], q->rx_pending + j);
+        virtqueue_recycle_element(q->rx_vq, elems[j]);
     }
 
-    virtqueue_flush(q->rx_vq, i);
-    virtio_notify(vdev, q->rx_vq);
+    q->rx_pending += i;
+    if (flush) {
+        virtio_net_flush_rx(n, q);
+    }
 
     return size;
 
 err:
     for (j = 0; j < i; j++) {
         virtqueue_detach_element(q->rx_vq, elems[j], lens[j]);
-        g_free(elems[j]);
+        virtqueue_recycle_element(q->rx_vq, elems[j]);
     }
 
     return err;
@@ -1997,7 +2038,7 @@ static ssize_t virtio_net_do_receive(NetClientState *nc, const uint8_t *buf,
 {
     RCU_READ_LOCK_GUARD();
 
-    return virtio_net_receive_rcu(nc, buf, size);
+    return virtio_net_receive_rcu(nc, buf, size, NULL, true);
 }
 
 /*
@@ -2608,17 +2649,539 @@ static ssize_t virtio_net_rsc_receive(NetClientState *nc,
     return virtio_net_do_receive(nc, buf, size);
 }
 
+/*
+ * Software GRO
+ *
+ * Backends without a vnet header hand over one MTU-sized frame at a time.
+ * If the guest accepts TSO packets, consecutive TCP segments of a flow are
+ * merged into one GSO packet, so that the guest takes a single RX buffer
+ * and interrupt for them.  Held flows are flushed at the end of a receive
+ * batch, or from a bottom half once the backend is done delivering packets
+ * in this main loop iteration.
+ *
+ * A segment is only held if the merged packet fits in the RX buffers;
+ * otherwise 0 is returned so that the backend queues it and retries.  A
+ * flow that cannot be delivered stays held until the guest adds buffers.
+ */
+
+#define VIRTIO_NET_GRO_BUF_SIZE (sizeof(struct eth_header) + \
+                                 sizeof(struct ip6_header) + \
+                                 VIRTIO_NET_MAX_TCP_PAYLOAD)
+
+typedef struct VirtioNetGroPkt {
+    uint16_t proto;
+    size_t size;            /* frame size without Ethernet padding */
+    uint16_t l4_off;
+    uint16_t payload_off;
+    uint16_t payload;
+    struct tcp_header *tcp;
+} VirtioNetGroPkt;
+
+static bool virtio_net_gro_active(VirtIONet *n)
+{
+    return n->rx_gro && !n->has_vnet_hdr &&
+        virtio_has_feature(n->curr_guest_offloads, VIRTIO_NET_F_GUEST_CSUM) &&
+        (virtio_has_feature(n->curr_guest_offloads, VIRTIO_NET_F_GUEST_TSO4) ||
+         virtio_has_feature(n->curr_guest_offloads, VIRTIO_NET_F_GUEST_TSO6));
+}
+
+/* Return true for a valid TCP segment that GRO can handle */
+static bool virtio_net_gro_parse(VirtIONet *n, const uint8_t *buf,
+                                 size_t size, VirtioNetGroPkt *pkt)
+{
+    const size_t l3_off = sizeof(struct eth_header);
+    uint16_t tcp_len, tcp_hdrlen;
+    uint32_t csum, cso;
+
+    if (size < l3_off + sizeof(struct ip_header) + sizeof(struct tcp_header)) {
+        return false;
+    }
+
+    pkt->proto = be16_to_cpu(PKT_GET_ETH_HDR(buf)->h_proto);
+    if (pkt->proto == ETH_P_IP) {
+        struct ip_header *ip = (struct ip_header *)(buf + l3_off);
+        uint16_t ip_len = be16_to_cpu(ip->ip_len);
+
+        if (!virtio_has_feature(n->curr_guest_offloads,
+                                VIRTIO_NET_F_GUEST_TSO4) ||
+            ip->ip_ver_len != ((IP_HEADER_VERSION_4 << 4) |
+                               VIRTIO_NET_IP4_HEADER_LENGTH) ||
+            ip->ip_p != IP_PROTO_TCP ||
+            (be16_to_cpu(ip->ip_off) & (IP_MF | IP_OFFMASK)) ||
+            IPTOS_ECN(ip->ip_tos) ||
+            ip_len < sizeof(*ip) + sizeof(struct tcp_header) ||
+            ip_len > size - l3_off ||
+            net_raw_checksum((uint8_t *)ip, sizeof(*ip))) {
+            return false;
+        }
+
+        pkt->l4_off = l3_off + sizeof(*ip);
+        tcp_len = ip_len - sizeof(*ip);
+        csum = eth_calc_ip4_pseudo_hdr_csum(ip, tcp_len, &cso);
+    } else if (pkt->proto == ETH_P_IPV6) {
+        struct ip6_header *ip6 = (struct ip6_header *)(buf + l3_off);
+
+        if (!virtio_has_feature(n->curr_guest_offloads,
+                                VIRTIO_NET_F_GUEST_TSO6) ||
+            size < l3_off + sizeof(*ip6) + sizeof(struct tcp_header) ||
+            (ip6->ip6_ctlun.ip6_un2_vfc >> 4) != IP_HEADER_VERSION_6 ||
+            ip6->ip6_ctlun.ip6_un1.ip6_un1_nxt != IP_PROTO_TCP ||
+            IP6_ECN(ip6->ip6_ctlun.ip6_un3.ip6_un3_ecn)) {
+            return false;
+        }
+
+        tcp_len = be16_to_cpu(ip6->ip6_ctlun.ip6_un1.ip6_un1_plen);
+        if (tcp_len < sizeof(struct tcp_header) ||
+            tcp_len > size - l3_off - sizeof(*ip6)) {
+            return false;
+        }
+
+        pkt->l4_off = l3_off + sizeof(*ip6);
+        csum = eth_calc_ip6_pseudo_hdr_csum(ip6, tcp_len, IP_PROTO_TCP, &cso);
+    } else {
+        return false;
+    }
+
+    pkt->tcp = (struct tcp_header *)(buf + pkt->l4_off);
+    tcp_hdrlen = TCP_HEADER_DATA_OFFSET(pkt->tcp);
+    if (tcp_hdrlen < sizeof(struct tcp_header) || tcp_hdrlen > tcp_len) {
+        return false;
+    }
+
+    /* The guest does not verify the checksum of what we deliver */
+    csum += net_checksum_add(tcp_len, (uint8_t *)pkt->tcp);
+    if (net_checksum_finish(csum)) {
+        return false;
+    }
+
+    pkt->size = pkt->l4_off + tcp_len;
+    pkt->payload_off = pkt->l4_off + tcp_hdrlen;
+    pkt->payload = tcp_len - tcp_hdrlen;
+    return true;
+}
+
+static VirtioNetGroFlow *virtio_net_gro_find_flow(VirtIONet *n,
+                                                  NetClientState *nc,
+                                                  const uint8_t *buf,
+                                                  const VirtioNetGroPkt *pkt)
+{
+    VirtioNetGroFlow *flow;
+    size_t addr_off, addr_len;
+
+    if (pkt->proto == ETH_P_IP) {
+        addr_off = sizeof(struct eth_header) +
+                   offsetof(struct ip_header, ip_src);
+        addr_len = VIRTIO_NET_IP4_ADDR_SIZE;
+    } else {
+        addr_off = sizeof(struct eth_header) +
+                   offsetof(struct ip6_header, ip6_src);
+        addr_len = VIRTIO_NET_IP6_ADDR_SIZE;
+    }
+
+    QTAILQ_FOREACH(flow, &n->gro_flows, next) {
+        if (flow->nc == nc && flow->proto == pkt->proto &&
+            !memcmp(flow->buf, buf, 2 * ETH_ALEN) &&
+            !memcmp(flow->buf + addr_off, buf + addr_off, addr_len) &&
+            !memcmp(flow->buf + flow->l4_off, buf + pkt->l4_off,
+                    VIRTIO_NET_TCP_PORT_SIZE)) {
+            return flow;
+        }
+    }
+
+    return NULL;
+}
+
+static bool virtio_net_gro_can_merge(VirtioNetGroFlow *flow,
+                                     const uint8_t *buf,
+                                     const VirtioNetGroPkt *pkt)
+{
+    struct tcp_header *tcp = (struct tcp_header *)(flow->buf + flow->l4_off);
+    const uint8_t *l3 = buf + sizeof(struct eth_header);
+    uint8_t *flow_l3 = flow->buf + sizeof(struct eth_header);
+    size_t tcp_hdrlen = pkt->payload_off - pkt->l4_off;
+    size_t max_size;
+
+    if (pkt->proto == ETH_P_IP) {
+        const struct ip_header *ip = (const struct ip_header *)l3;
+        struct ip_header *flow_ip = (struct ip_header *)flow_l3;
+
+        if (ip->ip_tos != flow_ip->ip_tos || ip->ip_ttl != flow_ip->ip_ttl ||
+            ((ip->ip_off ^ flow_ip->ip_off) & cpu_to_be16(IP_DF))) {
+            return false;
+        }
+        max_size = sizeof(struct eth_header) + VIRTIO_NET_MAX_TCP_PAYLOAD;
+    } else {
+        const struct ip6_header *ip6 = (const struct ip6_header *)l3;
+        struct ip6_header *flow_ip6 = (struct ip6_header *)flow_l3;
+
+        if (ip6->ip6_ctlun.ip6_un1.ip6_un1_flow !=
+            flow_ip6->ip6_ctlun.ip6_un1.ip6_un1_flow ||
+            ip6->ip6_ctlun.ip6_un1.ip6_un1_hlim !=
+            flow_ip6->ip6_ctlun.ip6_un1.ip6_un1_hlim) {
+            return false;
+        }
+        max_size = flow->l4_off + VIRTIO_NET_MAX_TCP_PAYLOAD;
+    }
+
+    /*
+     * Only append the next in-sequence segment of at most MSS bytes, after
+     * full-sized segments only, with the same ACK, window and options.
+     */
+    return flow->payload_off - flow->l4_off == tcp_hdrlen &&
+        be32_to_cpu(pkt->tcp->th_seq) == flow->next_seq &&
+        pkt->payload <= flow->mss &&
+        flow->size - flow->payload_off == (size_t)flow->mss * flow->segs &&
+        flow->size + pkt->payload <= max_size &&
+        pkt->tcp->th_ack == tcp->th_ack &&
+        pkt->tcp->th_win == tcp->th_win &&
+        !memcmp(pkt->tcp + 1, tcp + 1,
+                tcp_hdrlen - sizeof(struct tcp_header));
+}
+
+/* Return the RX queue that virtio_net_receive_rcu() picks for @buf */
+static VirtIONetQueue *virtio_net_gro_queue(VirtIONet *n, NetClientState *nc,
+                                            const uint8_t *buf, size_t size)
+{
+    if (n->rss_data.enabled && n->rss_data.enabled_software_rss) {
+        struct virtio_net_hdr_v1_hash hdr;
+        int index = virtio_net_process_rss(nc, buf, size, &hdr);
+
+        if (index >= 0) {
+            nc = qemu_get_subqueue(n->nic, index % n->curr_queue_pairs);
+        }
+    }
+    return virtio_net_get_subqueue(nc);
+}
+
+/* Return true if a frame of @size bytes fits in the RX buffers of @q */
+static bool virtio_net_gro_has_room(VirtIONet *n, VirtIONetQueue *q,
+                                    size_t size)
+{
+    return virtio_net_has_buffers(q, size + n->guest_hdr_len -
+                                  n->host_hdr_len);
+}
+
+/*
+ * Called within rcu_read_lock().  Return false, keeping the flow, if the
+ * guest has no room for it.
+ */
+static bool virtio_net_gro_flush_flow(VirtIONet *n, VirtioNetGroFlow *flow,
+                                      bool flush)
+{
+    VirtIODevice *vdev = VIRTIO_DEVICE(n);
+    uint8_t *l3 = flow->buf + sizeof(struct eth_header);
+    struct tcp_header *tcp = (struct tcp_header *)(flow->buf + flow->l4_off);
+    uint16_t tcp_len = flow->size - flow->l4_off;
+    struct virtio_net_hdr hdr = {
+        .gso_type = VIRTIO_NET_HDR_GSO_NONE,
+    };
+    uint32_t csum, cso;
+
+    if (flow->segs == 1) {
+        /* Its checksum has been verified already */
+        hdr.flags = VIRTIO_NET_HDR_F_DATA_VALID;
+    } else {
+        if (flow->proto == ETH_P_IP) {
+            struct ip_header *ip = (struct ip_header *)l3;
+
+            ip->ip_len = cpu_to_be16(flow->size - sizeof(struct eth_header));
+            eth_fix_ip4_checksum(ip, sizeof(*ip));
+            csum = eth_calc_ip4_pseudo_hdr_csum(ip, tcp_len, &cso);
+            hdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+        } else {
+            struct ip6_header *ip6 = (struct ip6_header *)l3;
+
+            ip6->ip6_ctlun.ip6_un1.ip6_un1_plen = cpu_to_be16(tcp_len);
+            csum = eth_calc_ip6_pseudo_hdr_csum(ip6, tcp_len, IP_PROTO_TCP,
+                                                &cso);
+            hdr.gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+        }
+
+        /* Leave the pseudo header sum for the guest to complete */
+        tcp->th_sum = cpu_to_be16(~net_checksum_finish(csum));
+        hdr.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        virtio_stw_p(vdev, &hdr.hdr_len, flow->payload_off);
+        virtio_stw_p(vdev, &hdr.gso_size, flow->mss);
+        virtio_stw_p(vdev, &hdr.csum_start, flow->l4_off);
+        virtio_stw_p(vdev, &hdr.csum_offset,
+                     offsetof(struct tcp_header, th_sum));
+    }
+
+    /* The headers are recomputed from scratch if this is retried */
+    if (!virtio_net_receive_rcu(flow->nc, flow->buf, flow->size, &hdr,
+                                flush)) {
+        return false;
+    }
+
+    QTAILQ_REMOVE(&n->gro_flows, flow, next);
+    QTAILQ_INSERT_TAIL(&n->gro_free, flow, next);
+    return true;
+}
+
+/* Called within rcu_read_lock().  Flows that do not fit stay held. */
+static void virtio_net_gro_flush(VirtIONet *n, bool flush)
+{
+    VirtioNetGroFlow *flow, *tmp;
+
+    QTAILQ_FOREACH_SAFE(flow, &n->gro_flows, next, tmp) {
+        virtio_net_gro_flush_flow(n, flow, flush);
+    }
+}
+
+/*
+ * Return true unless the frame certainly is not TCP.  IPv6 extension
+ * headers are not walked, so only UDP is excluded there.
+ */
+static bool virtio_net_gro_maybe_tcp(const uint8_t *buf, size_t size)
+{
+    const size_t l3_off = sizeof(struct eth_header);
+    uint16_t proto;
+
+    if (size < l3_off) {
+        return false;
+    }
+
+    proto = be16_to_cpu(PKT_GET_ETH_HDR(buf)->h_proto);
+    if (proto == ETH_P_IP && size >= l3_off + sizeof(struct ip_header)) {
+        return ((struct ip_header *)(buf + l3_off))->ip_p == IP_PROTO_TCP;
+    } else if (proto == ETH_P_IPV6 &&
+               size >= l3_off + sizeof(struct ip6_header)) {
+        return ((struct ip6_header *)(buf + l3_off))->
+               ip6_ctlun.ip6_un1.ip6_un1_nxt != IP_PROTO_UDP;
+    }
+    return false;
+}
+
+/*
+ * Called within rcu_read_lock().  Deliver all flows held for @nc, and
+ * return false if some of them did not fit.
+ */
+static bool virtio_net_gro_flush_nc(VirtIONet *n, NetClientState *nc,
+                                    bool flush)
+{
+    VirtioNetGroFlow *flow, *tmp;
+    bool ret = true;
+
+    QTAILQ_FOREACH_SAFE(flow, &n->gro_flows, next, tmp) {
+        if (flow->nc == nc && !virtio_net_gro_flush_flow(n, flow, flush)) {
+            ret = false;
+        }
+    }
+    return ret;
+}
+
+static void virtio_net_gro_bh(void *opaque)
+{
+    VirtIONet *n = opaque;
+
+    RCU_READ_LOCK_GUARD();
+    virtio_net_gro_flush(n, true);
+}
+
+/* Return false if no flow could be freed up for the segment */
+static bool virtio_net_gro_new_flow(VirtIONet *n, NetClientState *nc,
+                                    VirtIONetQueue *q, const uint8_t *buf,
+                                    const VirtioNetGroPkt *pkt, bool flush)
+{
+    VirtioNetGroFlow *flow;
+
+    if (QTAILQ_EMPTY(&n->gro_free)) {
+        if (n->gro_nflows < VIRTIO_NET_GRO_MAX_FLOWS) {
+            flow = g_new(VirtioNetGroFlow, 1);
+            flow->buf = g_malloc(VIRTIO_NET_GRO_BUF_SIZE);
+            QTAILQ_INSERT_TAIL(&n->gro_free, flow, next);
+            n->gro_nflows++;
+        } else if (!virtio_net_gro_flush_flow(n, QTAILQ_FIRST(&n->gro_flows),
+                                              flush)) {
+            /* Could not make room by delivering the oldest flow */
+            return false;
+        }
+    }
+
+    flow = QTAILQ_FIRST(&n->gro_free);
+    QTAILQ_REMOVE(&n->gro_free, flow, next);
+
+    memcpy(flow->buf, buf, pkt->size);
+    flow->nc = nc;
+    flow->q = q;
+    flow->size = pkt->size;
+    flow->proto = pkt->proto;
+    flow->l4_off = pkt->l4_off;
+    flow->payload_off = pkt->payload_off;
+    flow->mss = pkt->payload;
+    flow->segs = 1;
+    flow->next_seq = be32_to_cpu(pkt->tcp->th_seq) + pkt->payload;
+    QTAILQ_INSERT_TAIL(&n->gro_flows, flow, next);
+    return true;
+}
+
+/*
+ * Called within rcu_read_lock().  With @flush false, the caller flushes
+ * held flows and RX queues once it is done with the whole batch.
+ */
+static ssize_t virtio_net_gro_receive(NetClientState *nc, const uint8_t *buf,
+                                      size_t size, bool flush)
+{
+    VirtIONet *n = qemu_get_nic_opaque(nc);
+    VirtioNetGroFlow *flow;
+    VirtioNetGroPkt pkt;
+    uint8_t flags;
+
+    if (!virtio_net_gro_parse(n, buf, size, &pkt)) {
+        /*
+         * A segment that GRO does not handle, for example because of IP
+         * options or an ECN mark, must not overtake earlier data of its
+         * flow.  Rather than parsing it further, deliver all held flows.
+         */
+        if (virtio_net_gro_maybe_tcp(buf, size) &&
+            !virtio_net_gro_flush_nc(n, nc, flush)) {
+            return 0;
+        }
+        return virtio_net_receive_rcu(nc, buf, size, NULL, flush);
+    }
+
+    flow = virtio_net_gro_find_flow(n, nc, buf, &pkt);
+    flags = be16_to_cpu(pkt.tcp->th_offset_flags) & 0xff;
+
+    /* Control segments and pure ACKs are delivered right after the flow */
+    if ((flags & ~TH_PUSH) != TH_ACK || !pkt.payload) {
+        if (flow && !virtio_net_gro_flush_flow(n, flow, flush)) {
+            return 0;
+        }
+        return virtio_net_receive_rcu(nc, buf, size, NULL, flush);
+    }
+
+    if (!virtio_net_can_receive(nc)) {
+        return 0;
+    }
+
+    if (flow && virtio_net_gro_can_merge(flow, buf, &pkt)) {
+        struct tcp_header *tcp =
+            (struct tcp_header *)(flow->buf + flow->l4_off);
+
+        /* Only take what the guest can receive, or the backend retries */
+        if (!virtio_net_gro_has_room(n, flow->q, flow->size + pkt.payload)) {
+            virtio_net_gro_flush_flow(n, flow, flush);
+            return 0;
+        }
+        memcpy(flow->buf + flow->size, buf + pkt.payload_off, pkt.payload);
+        flow->size += pkt.payload;
+        flow->segs++;
+        flow->next_seq += pkt.payload;
+        tcp->th_offset_flags |= pkt.tcp->th_offset_flags & cpu_to_be16(TH_PUSH);
+    } else {
+        VirtIONetQueue *q = virtio_net_gro_queue(n, nc, buf, pkt.size);
+
+        if ((flow && !virtio_net_gro_flush_flow(n, flow, flush)) ||
+            !virtio_net_gro_has_room(n, q, pkt.size) ||
+            !virtio_net_gro_new_flow(n, nc, q, buf, &pkt, flush)) {
+            return 0;
+        }
+        flow = QTAILQ_LAST(&n->gro_flows);
+    }
+
+    /*
+     * The sender has no more data queued, don't delay it.  If the flow
+     * does not fit after all, it is retried once the guest adds buffers.
+     */
+    if (flags & TH_PUSH) {
+        virtio_net_gro_flush_flow(n, flow, flush);
+    } else if (flush) {
+        qemu_bh_schedule(n->gro_bh);
+    }
+
+    return size;
+}
+
+/* Drop held flows */
+static void virtio_net_gro_purge(VirtIONet *n)
+{
+    VirtioNetGroFlow *flow;
+
+    while ((flow = QTAILQ_FIRST(&n->gro_flows))) {
+        QTAILQ_REMOVE(&n->gro_flows, flow, next);
+        QTAILQ_INSERT_TAIL(&n->gro_free, flow, next);
+    }
+}
+
+static void virtio_net_gro_cleanup(VirtIONet *n)
+{
+    VirtioNetGroFlow *flow;
+
+    virtio_net_gro_purge(n);
+    while ((flow = QTAILQ_FIRST(&n->gro_free))) {
+        QTAILQ_REMOVE(&n->gro_free, flow, next);
+        g_free(flow->buf);
+        g_free(flow);
+    }
+    n->gro_nflows = 0;
+}
+
 static ssize_t virtio_net_receive(NetClientState *nc, const uint8_t *buf,
                                   size_t size)
 {
     VirtIONet *n = qemu_get_nic_opaque(nc);
     if ((n->rsc4_enabled || n->rsc6_enabled)) {
         return virtio_net_rsc_receive(nc, buf, size);
+    } else if (virtio_net_gro_active(n)) {
+        RCU_READ_LOCK_GUARD();
+        return virtio_net_gro_receive(nc, buf, size, true);
     } else {
         return virtio_net_do_receive(nc, buf, size);
     }
 }
 
+static int virtio_net_receive_batch(NetClientState *nc,
+                                    const NetPacketVec *pkts, int npkts)
+{
+    VirtIONet *n = qemu_get_nic_opaque(nc);
+    g_autofree uint8_t *linear = NULL;
+    bool gro = virtio_net_gro_active(n);
+    const uint8_t *buf;
+    size_t size;
+    ssize_t ret;
+    int i, j;
+
+    /*
+     * Fill RX buffers for the whole batch and publish them to the guest
+     * with a single used ring update and notification per queue.
+     */
+    RCU_READ_LOCK_GUARD();
+
+    for (i = 0; i < npkts; i++) {
+        size = iov_size(pkts[i].iov, pkts[i].iovcnt);
+        if (pkts[i].iovcnt == 1) {
+            buf = pkts[i].iov[0].iov_base;
+        } else {
+            linear = g_realloc(linear, size);
+            iov_to_buf(pkts[i].iov, pkts[i].iovcnt, 0, linear, size);
+            buf = linear;
+        }
+
+        if (n->rsc4_enabled || n->rsc6_enabled) {
+            ret = virtio_net_rsc_receive(nc, buf, size);
+        } else if (gro) {
+            ret = virtio_net_gro_receive(nc, buf, size, false);
+        } else {
+            ret = virtio_net_receive_rcu(nc, buf, size, NULL, false);
+        }
+        if (ret == 0) {
+            break;
+        }
+    }
+
+    if (gro) {
+        virtio_net_gro_flush(n, false);
+    }
+
+    /* Software RSS may have spread the batch over several queues */
+    for (j = 0; j < n->curr_queue_pairs; j++) {
+        virtio_net_flush_rx(n, &n->vqs[j]);
+    }
+
+    return i;
+}
+
 static int32_t virtio_net_flush_tx(VirtIONetQueue *q);
 
 static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
@@ -2631,7 +3194,7 @@ static void virtio_net_tx_complete(NetClientState *nc, ssize_t len)
     virtqueue_push(q->tx_vq, q->async_tx.elem, 0);
     virtio_notify(vdev, q->tx_vq);
 
-    g_free(q->async_tx.elem);
+    virtqueue_recycle_element(q->tx_vq, q->async_tx.elem);
     q->async_tx.elem = NULL;
 
     virtio_queue_set_notification(q->tx_vq, 1);
@@ -2742,7 +3305,7 @@ static int32_t virtio_net_flush_tx(VirtIONetQueue *q)
 drop:
         virtqueue_push(q->tx_vq, elem, 0);
         virtio_notify(vdev, q->tx_vq);
-        g_free(elem);
+        virtqueue_recycle_element(q->tx_vq, elem);
 
         if (++num_packets >= n->tx_burst) {
             break;
@@ -3034,9 +3597,12 @@ static uint64_t virtio_net_get_features(VirtIODevice *vdev, uint64_t features,
         virtio_clear_feature(&features, VIRTIO_NET_F_HOST_TSO6);
         virtio_clear_feature(&features, VIRTIO_NET_F_HOST_ECN);
 
-        virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_CSUM);
-        virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_TSO4);
-        virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_TSO6);
+        /* Software GRO produces TSO packets for the guest by itself */
+        if (!n->rx_gro) {
+            virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_CSUM);
+            virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_TSO4);
+            virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_TSO6);
+        }
         virtio_clear_feature(&features, VIRTIO_NET_F_GUEST_ECN);
 
         virtio_clear_feature(&features, VIRTIO_NET_F_HOST_USO);
@@ -3556,6 +4122,7 @@ static NetClientInfo net_virtio_info = {
     .size = sizeof(NICState),
     .can_receive = virtio_net_can_receive,
     .receive = virtio_net_receive,
+    .receive_batch = virtio_net_receive_batch,
     .link_status_changed = virtio_net_set_link_status,
     .query_rx_filter = virtio_net_query_rxfilter,
     .announce = virtio_net_announce,
@@ -3955,6 +4522,10 @@ static void virtio_net_device_realize(DeviceState *dev, Error **errp)
             (uint8_t *)&netcfg, 0, ETH_ALEN, VHOST_SET_CONFIG_TYPE_FRONTEND);
     }
     QTAILQ_INIT(&n->rsc_chains);
+    QTAILQ_INIT(&n->gro_flows);
+    QTAILQ_INIT(&n->gro_free);
+    n->gro_bh = qemu_bh_new_guarded(virtio_net_gro_bh, n,
+                                    &dev->mem_reentrancy_guard);
     n->qdev = dev;
 
     net_rx_pkt_init(&n->rx_pkt);
@@ -4012,6 +4583,8 @@ static void virtio_net_device_unrealize(DeviceState *dev)
     g_free(n->vqs);
     qemu_del_nic(n->nic);
     virtio_net_rsc_cleanup(n);
+    qemu_bh_delete(n->gro_bh);
+    virtio_net_gro_cleanup(n);
     g_free(n->rss_data.indirections_table);
     net_rx_pkt_uninit(n->rx_pkt);
     virtio_cleanup(vdev);
@@ -4049,6 +4622,8 @@ static void virtio_net_reset(VirtIODevice *vdev)
         flush_or_purge_queued_packets(qemu_get_subqueue(n->nic, i));
     }
 
+    virtio_net_gro_purge(n);
+
     virtio_net_disable_rss(n);
 }
 
@@ -4164,6 +4739,7 @@ static const Property virtio_net_properties[] = {
                     VIRTIO_NET_F_RSC_EXT, false),
     DEFINE_PROP_UINT32("rsc_interval", VirtIONet, rsc_timeout,
                        VIRTIO_NET_RSC_DEFAULT_INTERVAL),
+    DEFINE_PROP_BOOL("rx-gro", VirtIONet, rx_gro, false),
     DEFINE_NIC_PROPERTIES(VirtIONet, nic_conf),
     DEFINE_PROP_UINT32("x-txtimer", VirtIONet, net_conf.txtimer,
                        TX_TIMER_INTERVAL),
@@ -34,6 +34,9 @@ struct VhostIOVATree {
 
     /* GPA->IOVA address memory maps */
     IOVATree *gpa_iova_map;
+
+    /* Bumped every time a mapping is removed, see vhost_iova_tree_gen() */
+    uint64_t gen;
 };
 
 /**
@@ -43,7 +46,7 @@ struct VhostIOVATree {
  */
 VhostIOVATree *vhost_iova_tree_new(hwaddr iova_first, hwaddr iova_last)
 {
-    VhostIOVATree *tree = g_new(VhostIOVATree, 1);
+    VhostIOVATree *tree = g_new0(VhostIOVATree, 1);
 
     /* Some devices do not like 0 addresses */
     tree->iova_first = MAX(iova_first, iova_min_addr);
@@ -126,6 +129,7 @@ void vhost_iova_tree_remove(VhostIOVATree *iova_tree, DMAMap map)
 {
     iova_tree_remove(iova_tree->iova_taddr_map, map);
     iova_tree_remove(iova_tree->iova_map, map);
+    iova_tree->gen++;
 }
 
 /**
@@ -188,4 +192,20 @@ void vhost_iova_tree_remove_gpa(VhostIOVATree *iova_tree, DMAMap map)
 {
     iova_tree_remove(iova_tree->gpa_iova_map, map);
     iova_tree_remove(iova_tree->iova_map, map);
+    iova_tree->gen++;
+}
+
+/**
+ * Return the generation of the tree
+ *
+ * @tree: The VhostIOVATree
+ *
+ * The generation changes whenever a mapping is removed, so users that keep
+ * copies of the mappings returned by the find functions can tell when they
+ * must drop them.  Adding mappings does not change existing ones and does
+ * not bump the generation.
+ */
+uint64_t vhost_iova_tree_gen(const VhostIOVATree *tree)
+{
+    return tree->gen;
 }
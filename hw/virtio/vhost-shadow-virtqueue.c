@@ -71,6 +71,54 @@ uint16_t vhost_svq_available_slots(const VhostShadowVirtqueue *svq)
     return svq->num_free;
 }
 
+/**
+ * Look up a buffer in the SVQ cache of recently used IOVA mappings
+ *
+ * @svq: Shadow VirtQueue
+ * @taddr: Translated address of the buffer, GPA or HVA
+ * @len: Length of the buffer
+ * @gpa: True if taddr is a GPA
+ *
+ * Returns the cached mapping that contains the whole buffer, or NULL.
+ */
+static const DMAMap *vhost_svq_iova_cache_find(VhostShadowVirtqueue *svq,
+                                               hwaddr taddr, size_t len,
+                                               bool gpa)
+{
+    uint64_t gen = vhost_iova_tree_gen(svq->iova_tree);
+
+    if (unlikely(svq->iova_cache_gen != gen)) {
+        /* Some mapping was removed, the cache may point to stale ones */
+        memset(svq->iova_cache, 0, sizeof(svq->iova_cache));
+        svq->iova_cache_gen = gen;
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < VHOST_SVQ_IOVA_CACHE_SIZE; ++i) {
+        const SVQIOVACacheEntry *e = &svq->iova_cache[i];
+        hwaddr off = taddr - e->map.translated_addr;
+
+        if (e->valid && e->gpa == gpa && taddr >= e->map.translated_addr &&
+            off <= e->map.size && (len ? len - 1 : 0) <= e->map.size - off) {
+            return &e->map;
+        }
+    }
+
+    return NULL;
+}
+
+static void vhost_svq_iova_cache_add(VhostShadowVirtqueue *svq,
+                                     const DMAMap *map, bool gpa)
+{
+    SVQIOVACacheEntry *e = &svq->iova_cache[svq->iova_cache_next];
+
+    e->map = *map;
+    e->gpa = gpa;
+    e->valid = true;
+    svq->iova_cache_next = (svq->iova_cache_next + 1) %
+                           VHOST_SVQ_IOVA_CACHE_SIZE;
+}
+
 /**
  * Translate addresses between the qemu's virtual address and the SVQ IOVA
  *
@@ -79,8 +127,11 @@ uint16_t vhost_svq_available_slots(const VhostShadowVirtqueue *svq)
  * @iovec: Source qemu's VA addresses
  * @num: Length of iovec and minimum length of vaddr
  * @gpas: Descriptors' GPAs, if backed by guest memory
+ *
+ * Guest buffers are almost always found in the same few memory regions, so
+ * the mappings used last are looked up first before searching the trees.
  */
-static bool vhost_svq_translate_addr(const VhostShadowVirtqueue *svq,
+static bool vhost_svq_translate_addr(VhostShadowVirtqueue *svq,
                                      hwaddr *addrs, const struct iovec *iovec,
                                      size_t num, const hwaddr *gpas)
 {
@@ -96,18 +147,30 @@ static bool vhost_svq_translate_addr(const VhostShadowVirtqueue *svq,
 
         /* Check if the descriptor is backed by guest memory  */
         if (gpas) {
-            /* Search the GPA->IOVA tree */
             needle = (DMAMap) {
                 .translated_addr = gpas[i],
                 .size = iovec[i].iov_len,
             };
-            map = vhost_iova_tree_find_gpa(svq->iova_tree, &needle);
         } else {
-            /* Search the IOVA->HVA tree */
             needle = (DMAMap) {
                 .translated_addr = (hwaddr)(uintptr_t)iovec[i].iov_base,
                 .size = iovec[i].iov_len,
             };
+        }
+
+        map = vhost_svq_iova_cache_find(svq, needle.translated_addr,
+                                        iovec[i].iov_len, gpas != NULL);
+        if (map) {
+            addrs[i] = map->iova + (needle.translated_addr -
+                                    map->translated_addr);
+            continue;
+        }
+
+        if (gpas) {
+            /* Search the GPA->IOVA tree */
+            map = vhost_iova_tree_find_gpa(svq->iova_tree, &needle);
+        } else {
+            /* Search the IOVA->HVA tree */
             map = vhost_iova_tree_find_iova(svq->iova_tree, &needle);
         }
 
@@ -133,6 +196,8 @@ static bool vhost_svq_translate_addr(const VhostShadowVirtqueue *svq,
                           "Guest buffer expands over iova range");
             return false;
         }
+
+        vhost_svq_iova_cache_add(svq, map, gpas != NULL);
     }
 
     return true;
@@ -229,17 +294,27 @@ static bool vhost_svq_add_split(VhostShadowVirtqueue *svq,
     avail->ring[avail_idx] = cpu_to_le16(*head);
     svq->shadow_avail_idx++;
 
-    /* Update the avail index after write the descriptor */
-    smp_wmb();
-    avail->idx = cpu_to_le16(svq->shadow_avail_idx);
-
     return true;
 }
 
+/*
+ * Expose to the device all the entries added to the avail ring since the
+ * last call, and notify it if needed.
+ */
 static void vhost_svq_kick(VhostShadowVirtqueue *svq)
 {
+    uint16_t old = svq->kicked_avail_idx;
     bool needs_kick;
 
+    if (svq->shadow_avail_idx == old) {
+        return;
+    }
+
+    /* Update the avail index after write the descriptors */
+    smp_wmb();
+    svq->vring.avail->idx = cpu_to_le16(svq->shadow_avail_idx);
+    svq->kicked_avail_idx = svq->shadow_avail_idx;
+
     /*
      * We need to expose the available array entries before checking the used
      * flags
@@ -249,7 +324,7 @@ static void vhost_svq_kick(VhostShadowVirtqueue *svq)
     if (virtio_vdev_has_feature(svq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
         uint16_t avail_event = le16_to_cpu(
                 *(uint16_t *)(&svq->vring.used->ring[svq->vring.num]));
-        needs_kick = vring_need_event(avail_event, svq->shadow_avail_idx, svq->shadow_avail_idx - 1);
+        needs_kick = vring_need_event(avail_event, svq->shadow_avail_idx, old);
     } else {
         needs_kick =
                 !(svq->vring.used->flags & cpu_to_le16(VRING_USED_F_NO_NOTIFY));
@@ -262,15 +337,15 @@ static void vhost_svq_kick(VhostShadowVirtqueue *svq)
     event_notifier_set(&svq->hdev_kick);
 }
 
-/**
- * Add an element to a SVQ.
- *
- * Return -EINVAL if element is invalid, -ENOSPC if dev queue is full
+/*
+ * Add an element to the SVQ avail ring without exposing it to the device.
+ * vhost_svq_kick must be called afterwards.
  */
-int vhost_svq_add(VhostShadowVirtqueue *svq, const struct iovec *out_sg,
-                  size_t out_num, const hwaddr *out_addr,
-                  const struct iovec *in_sg, size_t in_num,
-                  const hwaddr *in_addr, VirtQueueElement *elem)
+static int vhost_svq_add_no_kick(VhostShadowVirtqueue *svq,
+                                 const struct iovec *out_sg, size_t out_num,
+                                 const hwaddr *out_addr,
+                                 const struct iovec *in_sg, size_t in_num,
+                                 const hwaddr *in_addr, VirtQueueElement *elem)
 {
     unsigned qemu_head;
     unsigned ndescs = in_num + out_num;
@@ -289,16 +364,36 @@ int vhost_svq_add(VhostShadowVirtqueue *svq, const struct iovec *out_sg,
     svq->num_free -= ndescs;
     svq->desc_state[qemu_head].elem = elem;
     svq->desc_state[qemu_head].ndescs = ndescs;
-    vhost_svq_kick(svq);
     return 0;
 }
 
-/* Convenience wrapper to add a guest's element to SVQ */
+/**
+ * Add an element to a SVQ.
+ *
+ * Return -EINVAL if element is invalid, -ENOSPC if dev queue is full
+ */
+int vhost_svq_add(VhostShadowVirtqueue *svq, const struct iovec *out_sg,
+                  size_t out_num, const hwaddr *out_addr,
+                  const struct iovec *in_sg, size_t in_num,
+                  const hwaddr *in_addr, VirtQueueElement *elem)
+{
+    int r = vhost_svq_add_no_kick(svq, out_sg, out_num, out_addr, in_sg,
+                                  in_num, in_addr, elem);
+
+    vhost_svq_kick(svq);
+    return r;
+}
+
+/*
+ * Convenience wrapper to add a guest's element to SVQ. The device is kicked
+ * by the caller once the whole batch has been added.
+ */
 static int vhost_svq_add_element(VhostShadowVirtqueue *svq,
                                  VirtQueueElement *elem)
 {
-    return vhost_svq_add(svq, elem->out_sg, elem->out_num, elem->out_addr,
-                         elem->in_sg, elem->in_num, elem->in_addr, elem);
+    return vhost_svq_add_no_kick(svq, elem->out_sg, elem->out_num,
+                                 elem->out_addr, elem->in_sg, elem->in_num,
+                                 elem->in_addr, elem);
 }
 
 /**
@@ -313,6 +408,9 @@ static int vhost_svq_add_element(VhostShadowVirtqueue *svq,
  *
  * If that happens, guest's kick notifications will be disabled until the
  * device uses some buffers.
+ *
+ * All the buffers forwarded in one call are exposed to the device with a
+ * single avail idx update and at most one kick.
  */
 static void vhost_handle_guest_kick(VhostShadowVirtqueue *svq)
 {
@@ -359,7 +457,7 @@ static void vhost_handle_guest_kick(VhostShadowVirtqueue *svq)
                 }
 
                 /* VQ is full or broken, just return and ignore kicks */
-                return;
+                goto out;
             }
             /* elem belongs to SVQ or external caller now */
             elem = NULL;
@@ -367,6 +465,9 @@ static void vhost_handle_guest_kick(VhostShadowVirtqueue *svq)
 
         virtio_queue_set_notification(svq->vq, true);
     } while (!virtio_queue_empty(svq->vq));
+
+out:
+    vhost_svq_kick(svq);
 }
 
 /**
@@ -687,11 +788,15 @@ void vhost_svq_start(VhostShadowVirtqueue *svq, VirtIODevice *vdev,
     event_notifier_set_handler(&svq->hdev_call, vhost_svq_handle_call);
     svq->next_guest_avail_elem = NULL;
     svq->shadow_avail_idx = 0;
+    svq->kicked_avail_idx = 0;
     svq->shadow_used_idx = 0;
     svq->last_used_idx = 0;
     svq->vdev = vdev;
     svq->vq = vq;
     svq->iova_tree = iova_tree;
+    memset(svq->iova_cache, 0, sizeof(svq->iova_cache));
+    svq->iova_cache_gen = vhost_iova_tree_gen(iova_tree);
+    svq->iova_cache_next = 0;
 
     svq->vring.num = virtio_queue_get_num(vdev, virtio_get_queue_index(vq));
     svq->num_free = svq->vring.num;
@@ -25,6 +25,19 @@ typedef struct SVQDescState {
     unsigned int ndescs;
 } SVQDescState;
 
+/* Number of recently used IOVA mappings cached by each SVQ */
+#define VHOST_SVQ_IOVA_CACHE_SIZE 4
+
+typedef struct SVQIOVACacheEntry {
+    /* Copy of the mapping found in the IOVA tree */
+    DMAMap map;
+
+    /* True if map is a GPA->IOVA mapping, false if it is IOVA->HVA */
+    bool gpa;
+
+    bool valid;
+} SVQIOVACacheEntry;
+
 typedef struct VhostShadowVirtqueue VhostShadowVirtqueue;
 
 /**
@@ -78,6 +91,15 @@ typedef struct VhostShadowVirtqueue {
     /* IOVA mapping */
     VhostIOVATree *iova_tree;
 
+    /* Mappings recently used to translate descriptors */
+    SVQIOVACacheEntry iova_cache[VHOST_SVQ_IOVA_CACHE_SIZE];
+
+    /* iova_tree generation the cache entries are valid for */
+    uint64_t iova_cache_gen;
+
+    /* Next iova_cache entry to replace */
+    unsigned iova_cache_next;
+
     /* SVQ vring descriptors state */
     SVQDescState *desc_state;
 
@@ -99,6 +121,9 @@ typedef struct VhostShadowVirtqueue {
     /* Next head to expose to the device */
     uint16_t shadow_avail_idx;
 
+    /* Avail idx the device has last been made aware of */
+    uint16_t kicked_avail_idx;
+
     /* Next free descriptor */
     uint16_t free_head;
 
@@ -17,6 +17,7 @@
 #include "qapi/error.h"
 #include "hw/virtio/vhost.h"
 #include "qemu/atomic.h"
+#include "qemu/cutils.h"
 #include "qemu/range.h"
 #include "qemu/error-report.h"
 #include "qemu/memfd.h"
@@ -81,6 +82,44 @@ unsigned int vhost_get_free_memslots(void)
     return free;
 }
 
+/*
+ * Number of log chunks that are checked at once for dirty bits.  With 64-bit
+ * chunks this is 512 bytes of log, or 16 MiB of guest memory.
+ */
+#define VHOST_LOG_SCAN_CHUNKS 64
+
+/* A run of contiguous dirty pages that is yet to be reported */
+typedef struct VhostLogDirtyRun {
+    hwaddr start;
+    hwaddr len;
+} VhostLogDirtyRun;
+
+static void vhost_log_flush_run(MemoryRegionSection *section,
+                                VhostLogDirtyRun *run)
+{
+    hwaddr section_offset, mr_offset;
+
+    if (!run->len) {
+        return;
+    }
+    section_offset = run->start - section->offset_within_address_space;
+    mr_offset = section_offset + section->offset_within_region;
+    memory_region_set_dirty(section->mr, mr_offset, run->len);
+    run->len = 0;
+}
+
+static void vhost_log_add_run(MemoryRegionSection *section,
+                              VhostLogDirtyRun *run, hwaddr start, hwaddr len)
+{
+    if (run->len && run->start + run->len == start) {
+        run->len += len;
+        return;
+    }
+    vhost_log_flush_run(section, run);
+    run->start = start;
+    run->len = len;
+}
+
 static void vhost_dev_sync_region(struct vhost_dev *dev,
                                   MemoryRegionSection *section,
                                   uint64_t mfirst, uint64_t mlast,
@@ -93,6 +132,7 @@ static void vhost_dev_sync_region(struct vhost_dev *dev,
     vhost_log_chunk_t *from = dev_log + start / VHOST_LOG_CHUNK;
     vhost_log_chunk_t *to = dev_log + end / VHOST_LOG_CHUNK + 1;
     uint64_t addr = QEMU_ALIGN_DOWN(start, VHOST_LOG_CHUNK);
+    VhostLogDirtyRun run = { 0 };
 
     if (end < start) {
         return;
@@ -100,30 +140,45 @@ static void vhost_dev_sync_region(struct vhost_dev *dev,
     assert(end / VHOST_LOG_CHUNK < dev->log_size);
     assert(start / VHOST_LOG_CHUNK < dev->log_size);
 
-    for (;from < to; ++from) {
-        vhost_log_chunk_t log;
+    while (from < to) {
+        size_t n = MIN(to - from, VHOST_LOG_SCAN_CHUNKS);
+        vhost_log_chunk_t *scan_end = from + n;
+
         /* We first check with non-atomic: much cheaper,
          * and we expect non-dirty to be the common case. */
-        if (!*from) {
-            addr += VHOST_LOG_CHUNK;
+        if (buffer_is_zero(from, n * sizeof(*from))) {
+            from = scan_end;
+            addr += n * VHOST_LOG_CHUNK;
             continue;
         }
-        /* Data must be read atomically. We don't really need barrier semantics
-         * but it's easier to use atomic_* than roll our own. */
-        log = qatomic_xchg(from, 0);
-        while (log) {
-            int bit = ctzl(log);
-            hwaddr page_addr;
-            hwaddr section_offset;
-            hwaddr mr_offset;
-            page_addr = addr + bit * VHOST_LOG_PAGE;
-            section_offset = page_addr - section->offset_within_address_space;
-            mr_offset = section_offset + section->offset_within_region;
-            memory_region_set_dirty(section->mr, mr_offset, VHOST_LOG_PAGE);
-            log &= ~(0x1ull << bit);
+
+        for (; from < scan_end; ++from, addr += VHOST_LOG_CHUNK) {
+            vhost_log_chunk_t log;
+
+            if (!*from) {
+                continue;
+            }
+            /* Data must be read atomically. We don't really need barrier
+             * semantics but it's easier to use atomic_* than roll our own. */
+            log = qatomic_xchg(from, 0);
+            while (log) {
+                int bit = ctzl(log);
+                int len = cto64(log >> bit);
+
+                /*
+                 * Report contiguous dirty pages together, even across
+                 * chunks, rather than one page at a time.
+                 */
+                vhost_log_add_run(section, &run, addr + bit * VHOST_LOG_PAGE,
+                                  (hwaddr)len * VHOST_LOG_PAGE);
+                if (bit + len >= VHOST_LOG_BITS) {
+                    break;
+                }
+                log &= ~0UL << (bit + len);
+            }
         }
-        addr += VHOST_LOG_CHUNK;
     }
+    vhost_log_flush_run(section, &run);
 }
 
 bool vhost_dev_has_iommu(struct vhost_dev *dev)
@@ -30,8 +30,10 @@
 #include "hw/virtio/virtio-bus.h"
 #include "hw/qdev-properties.h"
 #include "hw/virtio/virtio-access.h"
+#include "system/address-spaces.h"
 #include "system/dma.h"
 #include "system/runstate.h"
+#include "system/xen.h"
 #include "virtio-qmp.h"
 
 #include "standard-headers/linux/virtio_ids.h"
@@ -59,6 +61,24 @@
  */
 #define VIRTIO_PCI_VRING_ALIGN         4096
 
+/*
+ * Each virtqueue keeps up to VIRTQUEUE_ELEM_POOL_SIZE completed elements
+ * for reuse, so that popping short descriptor chains (up to
+ * VIRTQUEUE_ELEM_POOL_SG entries) does not need to allocate memory.
+ */
+#define VIRTQUEUE_ELEM_POOL_SIZE       64
+#define VIRTQUEUE_ELEM_POOL_SG         16
+
+/*
+ * Descriptor buffers and indirect tables are translated through a small
+ * per-ring cache of guest RAM mappings, each covering up to
+ * VRING_MAP_CACHE_WINDOW bytes.  The cache lives in the ring's
+ * VRingMemoryRegionCaches, so it is dropped whenever the memory map
+ * changes.
+ */
+#define VRING_MAP_CACHE_SIZE           8
+#define VRING_MAP_CACHE_WINDOW         (1ULL << 30)
+
 typedef struct VRingDesc
 {
     uint64_t addr;
@@ -94,11 +114,22 @@ typedef struct VRingUsed
     VRingUsedElem ring[];
 } VRingUsed;
 
+typedef struct VRingMapCacheEntry {
+    /* Guest physical address of map.ptr */
+    hwaddr addr;
+    MemoryRegionCache map;
+} VRingMapCacheEntry;
+
 typedef struct VRingMemoryRegionCaches {
     struct rcu_head rcu;
     MemoryRegionCache desc;
     MemoryRegionCache avail;
     MemoryRegionCache used;
+
+    /* Only accessed by the thread that pops from the virtqueue */
+    VRingMapCacheEntry map_cache[VRING_MAP_CACHE_SIZE];
+    unsigned int map_cache_count;
+    unsigned int map_cache_next;
 } VRingMemoryRegionCaches;
 
 typedef struct VRing
@@ -153,6 +184,11 @@ struct VirtQueue
     EventNotifier host_notifier;
     bool host_notifier_enabled;
     QLIST_ENTRY(VirtQueue) node;
+
+    /* Elements returned by virtqueue_recycle_element() */
+    VirtQueueElement *elem_pool[VIRTQUEUE_ELEM_POOL_SIZE];
+    unsigned int elem_pool_count;
+    size_t elem_pool_sz;
 };
 
 const char *virtio_device_names[] = {
@@ -217,7 +253,12 @@ static void virtio_check_indirect_feature(VirtIODevice *vdev)
 /* Called within call_rcu().  */
 static void virtio_free_region_cache(VRingMemoryRegionCaches *caches)
 {
+    unsigned int i;
+
     assert(caches != NULL);
+    for (i = 0; i < caches->map_cache_count; i++) {
+        address_space_cache_destroy(&caches->map_cache[i].map);
+    }
     address_space_cache_destroy(&caches->desc);
     address_space_cache_destroy(&caches->avail);
     address_space_cache_destroy(&caches->used);
@@ -676,26 +717,6 @@ static inline bool is_desc_avail(uint16_t flags, bool wrap_counter)
     return (avail != used) && (avail == wrap_counter);
 }
 
-/* Fetch avail_idx from VQ memory only when we really need to know if
- * guest has added some buffers.
- * Called within rcu_read_lock().  */
-static int virtio_queue_empty_rcu(VirtQueue *vq)
-{
-    if (virtio_device_disabled(vq->vdev)) {
-        return 1;
-    }
-
-    if (unlikely(!vq->vring.avail)) {
-        return 1;
-    }
-
-    if (vq->shadow_avail_idx != vq->last_avail_idx) {
-        return 0;
-    }
-
-    return vring_avail_idx(vq) == vq->last_avail_idx;
-}
-
 static int virtio_queue_split_empty(VirtQueue *vq)
 {
     bool empty;
@@ -1571,7 +1592,118 @@ int virtqueue_avail_bytes(VirtQueue *vq, unsigned int in_bytes,
     return in_bytes <= in_total && out_bytes <= out_total;
 }
 
-static bool virtqueue_map_desc(VirtIODevice *vdev, unsigned int *p_num_sg,
+/*
+ * Called within rcu_read_lock() by the thread that pops from the
+ * virtqueue.  Return the cached mapping that covers @pa, creating it if
+ * needed, or NULL if @pa is not in RAM that can be accessed directly.
+ */
+static VRingMapCacheEntry *
+vring_map_cache_lookup(VirtIODevice *vdev, VRingMemoryRegionCaches *caches,
+                       hwaddr pa)
+{
+    VRingMapCacheEntry *e;
+    unsigned int i;
+    hwaddr base;
+
+    /*
+     * Translations through an IOMMU can change without a memory map
+     * update, and Xen mappings are not permanent.
+     */
+    if (vdev->dma_as != &address_space_memory || xen_enabled()) {
+        return NULL;
+    }
+
+    for (i = 0; i < caches->map_cache_count; i++) {
+        e = &caches->map_cache[i];
+        if (pa >= e->addr && pa - e->addr < e->map.len) {
+            return e->map.ptr ? e : NULL;
+        }
+    }
+
+    if (caches->map_cache_count < VRING_MAP_CACHE_SIZE) {
+        e = &caches->map_cache[caches->map_cache_count++];
+    } else {
+        e = &caches->map_cache[caches->map_cache_next];
+        caches->map_cache_next = (caches->map_cache_next + 1) %
+                                 VRING_MAP_CACHE_SIZE;
+        address_space_cache_destroy(&e->map);
+    }
+
+    /*
+     * Try to cover the whole window around @pa, so that neighbouring
+     * buffers hit the same entry, otherwise start the mapping at @pa.
+     * Entries that are not RAM are kept too, so that MMIO is not looked
+     * up again for every descriptor.
+     */
+    base = QEMU_ALIGN_DOWN(pa, VRING_MAP_CACHE_WINDOW);
+    if (address_space_cache_init(&e->map, vdev->dma_as, base,
+                                 VRING_MAP_CACHE_WINDOW, true) <= pa - base) {
+        address_space_cache_destroy(&e->map);
+        base = pa;
+        address_space_cache_init(&e->map, vdev->dma_as, base,
+                                 VRING_MAP_CACHE_WINDOW, true);
+    }
+    e->addr = base;
+
+    return e->map.ptr ? e : NULL;
+}
+
+/*
+ * Like dma_memory_map(), but using the ring's mapping cache.  The result
+ * is unmapped with dma_memory_unmap() as usual.  Returns NULL if the
+ * buffer has to be mapped the slow way.
+ */
+static void *vring_map_cache_map(VirtIODevice *vdev,
+                                 VRingMemoryRegionCaches *caches,
+                                 hwaddr pa, hwaddr *plen)
+{
+    VRingMapCacheEntry *e = vring_map_cache_lookup(vdev, caches, pa);
+    hwaddr offset;
+
+    if (!e) {
+        return NULL;
+    }
+
+    offset = pa - e->addr;
+    *plen = MIN(*plen, e->map.len - offset);
+
+    /* Taken by address_space_map() as well, dropped on unmap */
+    memory_region_ref(e->map.mrs.mr);
+    return e->map.ptr + offset;
+}
+
+/*
+ * Prepare @cache for reading an indirect descriptor table of @len bytes
+ * at @pa.  If the table is in a cached mapping, @cache borrows it and
+ * holds no reference of its own, so that address_space_cache_destroy()
+ * does nothing.
+ */
+static int64_t vring_indirect_cache_init(VirtIODevice *vdev,
+                                         VRingMemoryRegionCaches *caches,
+                                         MemoryRegionCache *cache,
+                                         hwaddr pa, hwaddr len)
+{
+    VRingMapCacheEntry *e = vring_map_cache_lookup(vdev, caches, pa);
+    hwaddr offset;
+
+    if (!e || e->map.len - (pa - e->addr) < len) {
+        return address_space_cache_init(cache, vdev->dma_as, pa, len, false);
+    }
+
+    offset = pa - e->addr;
+    *cache = e->map;
+    cache->ptr += offset;
+    cache->xlat += offset;
+    cache->len = len;
+    cache->is_write = false;
+    cache->mrs.mr = NULL;
+    cache->fv = NULL;
+    return len;
+}
+
+static bool virtqueue_map_desc(VirtIODevice *vdev,
+                               VRingMemoryRegionCaches *caches,
+                               unsigned int *p_num_sg,
                                hwaddr *addr, struct iovec *iov,
                                unsigned int max_num_sg, bool is_write,
                                hwaddr pa, size_t sz)
@@ -1594,11 +1726,14 @@ static bool virtqueue_map_desc(VirtIODevice *vdev, unsigned int *p_num_sg,
             goto out;
         }
 
-        iov[num_sg].iov_base = dma_memory_map(vdev->dma_as, pa, &len,
-                                              is_write ?
-                                              DMA_DIRECTION_FROM_DEVICE :
-                                              DMA_DIRECTION_TO_DEVICE,
-                                              MEMTXATTRS_UNSPECIFIED);
+        iov[num_sg].iov_base = vring_map_cache_map(vdev, caches, pa, &len);
+        if (!iov[num_sg].iov_base) {
+            iov[num_sg].iov_base = dma_memory_map(vdev->dma_as, pa, &len,
+                                                  is_write ?
+                                                  DMA_DIRECTION_FROM_DEVICE :
+                                                  DMA_DIRECTION_TO_DEVICE,
+                                                  MEMTXATTRS_UNSPECIFIED);
+        }
         if (!iov[num_sg].iov_base) {
             virtio_error(vdev, "virtio: bogus descriptor or out of resources");
             goto out;
@@ -1667,9 +1802,14 @@ void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem)
                                                                         false);
 }
 
-static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_num)
+/*
+ * Lay out the address and scatter/gather arrays behind the first @sz
+ * bytes of @elem, or only compute the space needed if @elem is NULL.
+ * The size only depends on out_num + in_num, not on how they are split.
+ */
+static size_t virtqueue_element_layout(VirtQueueElement *elem, size_t sz,
+                                       unsigned out_num, unsigned in_num)
 {
-    VirtQueueElement *elem;
     size_t in_addr_ofs = QEMU_ALIGN_UP(sz, __alignof__(elem->in_addr[0]));
     size_t out_addr_ofs = in_addr_ofs + in_num * sizeof(elem->in_addr[0]);
     size_t out_addr_end = out_addr_ofs + out_num * sizeof(elem->out_addr[0]);
@@ -1677,22 +1817,92 @@ static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_nu
     size_t out_sg_ofs = in_sg_ofs + in_num * sizeof(elem->in_sg[0]);
     size_t out_sg_end = out_sg_ofs + out_num * sizeof(elem->out_sg[0]);
 
+    if (elem) {
+        elem->out_num = out_num;
+        elem->in_num = in_num;
+        elem->in_addr = (void *)elem + in_addr_ofs;
+        elem->out_addr = (void *)elem + out_addr_ofs;
+        elem->in_sg = (void *)elem + in_sg_ofs;
+        elem->out_sg = (void *)elem + out_sg_ofs;
+    }
+    return out_sg_end;
+}
+
+static void *virtqueue_alloc_element(size_t sz, unsigned out_num, unsigned in_num)
+{
+    VirtQueueElement *elem;
+
     assert(sz >= sizeof(VirtQueueElement));
-    elem = g_malloc(out_sg_end);
+    elem = g_malloc(virtqueue_element_layout(NULL, sz, out_num, in_num));
     trace_virtqueue_alloc_element(elem, sz, in_num, out_num);
-    elem->out_num = out_num;
-    elem->in_num = in_num;
-    elem->in_addr = (void *)elem + in_addr_ofs;
-    elem->out_addr = (void *)elem + out_addr_ofs;
-    elem->in_sg = (void *)elem + in_sg_ofs;
-    elem->out_sg = (void *)elem + out_sg_ofs;
+    virtqueue_element_layout(elem, sz, out_num, in_num);
+    elem->pooled = false;
     return elem;
 }
 
-static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
+/*
+ * Like virtqueue_alloc_element(), but take the element from @vq's pool
+ * of recycled elements when possible.  Pooled elements are sized for
+ * VIRTQUEUE_ELEM_POOL_SG entries, so any of them fits a chain that is
+ * not longer than that.  Only one element size is pooled per queue,
+ * which is all that devices use in practice.
+ */
+static void *virtqueue_get_element(VirtQueue *vq, size_t sz,
+                                   unsigned out_num, unsigned in_num)
+{
+    VirtQueueElement *elem;
+
+    if (out_num + in_num > VIRTQUEUE_ELEM_POOL_SG) {
+        return virtqueue_alloc_element(sz, out_num, in_num);
+    }
+
+    if (!vq->elem_pool_sz) {
+        vq->elem_pool_sz = sz;
+    } else if (vq->elem_pool_sz != sz) {
+        return virtqueue_alloc_element(sz, out_num, in_num);
+    }
+
+    if (vq->elem_pool_count) {
+        elem = vq->elem_pool[--vq->elem_pool_count];
+    } else {
+        assert(sz >= sizeof(VirtQueueElement));
+        elem = g_malloc(virtqueue_element_layout(NULL, sz,
+                                                 VIRTQUEUE_ELEM_POOL_SG, 0));
+    }
+    trace_virtqueue_alloc_element(elem, sz, in_num, out_num);
+    virtqueue_element_layout(elem, sz, out_num, in_num);
+    elem->pooled = true;
+    return elem;
+}
+
+void virtqueue_recycle_element(VirtQueue *vq, void *elem)
+{
+    VirtQueueElement *e = elem;
+
+    if (e->pooled && vq->elem_pool_count < VIRTQUEUE_ELEM_POOL_SIZE) {
+        vq->elem_pool[vq->elem_pool_count++] = e;
+    } else {
+        g_free(e);
+    }
+}
+
+static void virtqueue_elem_pool_drain(VirtQueue *vq)
+{
+    while (vq->elem_pool_count) {
+        g_free(vq->elem_pool[--vq->elem_pool_count]);
+    }
+    vq->elem_pool_sz = 0;
+}
+
+/*
+ * Called within rcu_read_lock(), once the caller has made sure that an
+ * element is available and ordered the avail index read against the
+ * descriptor reads.
+ */
+static void *virtqueue_split_pop_rcu(VirtQueue *vq, size_t sz,
+                                     VRingMemoryRegionCaches *caches)
 {
     unsigned int i, head, max, idx;
-    VRingMemoryRegionCaches *caches;
     MemoryRegionCache indirect_desc_cache;
     MemoryRegionCache *desc_cache;
     int64_t len;
@@ -1706,14 +1916,6 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
 
     address_space_cache_init_empty(&indirect_desc_cache);
 
-    RCU_READ_LOCK_GUARD();
-    if (virtio_queue_empty_rcu(vq)) {
-        goto done;
-    }
-    /* Needed after virtio_queue_empty(), see comment in
-     * virtqueue_num_heads(). */
-    smp_rmb();
-
     /* When we start there are none of either input nor output. */
     out_num = in_num = elem_entries = 0;
 
@@ -1728,18 +1930,8 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
         goto done;
     }
 
-    if (virtio_vdev_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX)) {
-        vring_set_avail_event(vq, vq->last_avail_idx);
-    }
-
     i = head;
 
-    caches = vring_get_region_caches(vq);
-    if (!caches) {
-        virtio_error(vdev, "Region caches not initialized");
-        goto done;
-    }
-
     if (caches->desc.len < max * sizeof(VRingDesc)) {
         virtio_error(vdev, "Cannot map descriptor ring");
         goto done;
@@ -1755,8 +1947,8 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
         virtio_check_indirect_feature(vdev);
 
         /* loop over the indirect descriptor table */
-        len = address_space_cache_init(&indirect_desc_cache, vdev->dma_as,
-                                       desc.addr, desc.len, false);
+        len = vring_indirect_cache_init(vdev, caches, &indirect_desc_cache,
+                                        desc.addr, desc.len);
         desc_cache = &indirect_desc_cache;
         if (len < desc.len) {
             virtio_error(vdev, "Cannot map indirect buffer");
@@ -1773,7 +1965,7 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
         bool map_ok;
 
         if (desc.flags & VRING_DESC_F_WRITE) {
-            map_ok = virtqueue_map_desc(vdev, &in_num, addr + out_num,
+            map_ok = virtqueue_map_desc(vdev, caches, &in_num, addr + out_num,
                                         iov + out_num,
                                         VIRTQUEUE_MAX_SIZE - out_num, true,
                                         desc.addr, desc.len);
@@ -1782,7 +1974,7 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
                 virtio_error(vdev, "Incorrect order for descriptors");
                 goto err_undo_map;
             }
-            map_ok = virtqueue_map_desc(vdev, &out_num, addr, iov,
+            map_ok = virtqueue_map_desc(vdev, caches, &out_num, addr, iov,
                                         VIRTQUEUE_MAX_SIZE, false,
                                         desc.addr, desc.len);
         }
@@ -1804,7 +1996,7 @@ static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_get_element(vq, sz, out_num, in_num);
     elem->index = head;
     elem->ndescs = 1;
     for (i = 0; i < out_num; i++) {
@@ -1836,6 +2028,60 @@ err_undo_map:
     goto done;
 }
 
+/*
+ * Pop up to @max elements with a single avail index read, barrier and
+ * region cache lookup.
+ */
+static unsigned int virtqueue_split_pop_batch(VirtQueue *vq, size_t sz,
+                                              void **elems, unsigned int max)
+{
+    VRingMemoryRegionCaches *caches;
+    uint16_t start = vq->last_avail_idx;
+    unsigned int n = 0;
+    int num_heads;
+
+    RCU_READ_LOCK_GUARD();
+    if (unlikely(!vq->vring.avail)) {
+        return 0;
+    }
+
+    /* Also orders the descriptor reads after the avail index read. */
+    num_heads = virtqueue_num_heads(vq, vq->last_avail_idx);
+    if (num_heads <= 0) {
+        return 0;
+    }
+
+    caches = vring_get_region_caches(vq);
+    if (!caches) {
+        virtio_error(vq->vdev, "Region caches not initialized");
+        return 0;
+    }
+
+    max = MIN(max, num_heads);
+    while (n < max) {
+        elems[n] = virtqueue_split_pop_rcu(vq, sz, caches);
+        if (!elems[n]) {
+            break;
+        }
+        n++;
+    }
+
+    if (vq->last_avail_idx != start &&
+        virtio_vdev_has_feature(vq->vdev, VIRTIO_RING_F_EVENT_IDX)) {
+        vring_set_avail_event(vq, vq->last_avail_idx);
+    }
+
+    return n;
+}
+
+static void *virtqueue_split_pop(VirtQueue *vq, size_t sz)
+{
+    void *elem = NULL;
+
+    virtqueue_split_pop_batch(vq, sz, &elem, 1);
+    return elem;
+}
+
 static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
 {
     unsigned int i, max;
@@ -1893,8 +2139,8 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
         virtio_check_indirect_feature(vdev);
 
         /* loop over the indirect descriptor table */
-        len = address_space_cache_init(&indirect_desc_cache, vdev->dma_as,
-                                       desc.addr, desc.len, false);
+        len = vring_indirect_cache_init(vdev, caches, &indirect_desc_cache,
+                                        desc.addr, desc.len);
         desc_cache = &indirect_desc_cache;
         if (len < desc.len) {
             virtio_error(vdev, "Cannot map indirect buffer");
@@ -1911,7 +2157,7 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
         bool map_ok;
 
         if (desc.flags & VRING_DESC_F_WRITE) {
-            map_ok = virtqueue_map_desc(vdev, &in_num, addr + out_num,
+            map_ok = virtqueue_map_desc(vdev, caches, &in_num, addr + out_num,
                                         iov + out_num,
                                         VIRTQUEUE_MAX_SIZE - out_num, true,
                                         desc.addr, desc.len);
@@ -1920,7 +2166,7 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
                 virtio_error(vdev, "Incorrect order for descriptors");
                 goto err_undo_map;
             }
-            map_ok = virtqueue_map_desc(vdev, &out_num, addr, iov,
+            map_ok = virtqueue_map_desc(vdev, caches, &out_num, addr, iov,
                                         VIRTQUEUE_MAX_SIZE, false,
                                         desc.addr, desc.len);
         }
@@ -1945,7 +2191,7 @@ static void *virtqueue_packed_pop(VirtQueue *vq, size_t sz)
     }
 
     /* Now copy what we have collected and mapped */
-    elem = virtqueue_alloc_element(sz, out_num, in_num);
+    elem = virtqueue_get_element(vq, sz, out_num, in_num);
     for (i = 0; i < out_num; i++) {
         elem->out_addr[i] = addr[i];
         elem->out_sg[i] = iov[i];
@@ -1999,6 +2245,30 @@ void *virtqueue_pop(VirtQueue *vq, size_t sz)
     }
 }
 
+unsigned int virtqueue_pop_batch(VirtQueue *vq, size_t sz, void **elems,
+                                 unsigned int max)
+{
+    unsigned int n = 0;
+
+    if (virtio_device_disabled(vq->vdev)) {
+        return 0;
+    }
+
+    if (!virtio_vdev_has_feature(vq->vdev, VIRTIO_F_RING_PACKED)) {
+        return virtqueue_split_pop_batch(vq, sz, elems, max);
+    }
+
+    /* Packed ring descriptors each carry their own availability flag */
+    while (n < max) {
+        elems[n] = virtqueue_packed_pop(vq, sz);
+        if (!elems[n]) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
 static unsigned int virtqueue_packed_drop_all(VirtQueue *vq)
 {
     VRingMemoryRegionCaches *caches;
@@ -2543,6 +2813,7 @@ void virtio_delete_queue(VirtQueue *vq)
     vq->handle_output = NULL;
     g_free(vq->used_elems);
     vq->used_elems = NULL;
+    virtqueue_elem_pool_drain(vq);
     virtio_virtqueue_reset_region_cache(vq);
 }
 
@@ -4024,6 +4295,7 @@ static void virtio_device_free_virtqueues(VirtIODevice *vdev)
         if (vdev->vq[i].vring.num == 0) {
             break;
         }
+        virtqueue_elem_pool_drain(&vdev->vq[i]);
         virtio_virtqueue_reset_region_cache(&vdev->vq[i]);
     }
     g_free(vdev->vq);
@@ -603,6 +603,22 @@ float32 float32_rem(float32, float32, float_status *status);
 float32 float32_muladd(float32, float32, float32, int, float_status *status);
 float32 float32_muladd_scalbn(float32, float32, float32,
                               int, int, float_status *status);
+
+/*
+ * Batch operations: d[i] = a[i] op b[i] for 0 <= i < n, with the same
+ * results and flags as the scalar functions.  d may overlap a and b.
+ */
+void float32_add_batch(float32 *d, const float32 *a, const float32 *b,
+                       size_t n, float_status *status);
+void float32_sub_batch(float32 *d, const float32 *a, const float32 *b,
+                       size_t n, float_status *status);
+void float32_mul_batch(float32 *d, const float32 *a, const float32 *b,
+                       size_t n, float_status *status);
+void float32_div_batch(float32 *d, const float32 *a, const float32 *b,
+                       size_t n, float_status *status);
+/* d[i] = float32_muladd(a[i], b[i], c[i], 0, status) */
+void float32_muladd_batch(float32 *d, const float32 *a, const float32 *b,
+                          const float32 *c, size_t n, float_status *status);
 float32 float32_sqrt(float32, float_status *status);
 float32 float32_exp2(float32, float_status *status);
 float32 float32_log2(float32, float_status *status);
@@ -800,6 +816,16 @@ float64 float64_rem(float64, float64, float_status *status);
 float64 float64_muladd(float64, float64, float64, int, float_status *status);
 float64 float64_muladd_scalbn(float64, float64, float64,
                               int, int, float_status *status);
+void float64_add_batch(float64 *d, const float64 *a, const float64 *b,
+                       size_t n, float_status *status);
+void float64_sub_batch(float64 *d, const float64 *a, const float64 *b,
+                       size_t n, float_status *status);
+void float64_mul_batch(float64 *d, const float64 *a, const float64 *b,
+                       size_t n, float_status *status);
+void float64_div_batch(float64 *d, const float64 *a, const float64 *b,
+                       size_t n, float_status *status);
+void float64_muladd_batch(float64 *d, const float64 *a, const float64 *b,
+                          const float64 *c, size_t n, float_status *status);
 float64 float64_sqrt(float64, float_status *status);
 float64 float64_log2(float64, float_status *status);
 FloatRelation float64_compare(float64, float64, float_status *status);
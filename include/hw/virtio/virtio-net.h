@@ -133,6 +133,24 @@ typedef struct VirtioNetRscChain {
     VirtioNetRscStat stat;
 } VirtioNetRscChain;
 
+/* Maximum number of TCP flows held by software GRO at the same time */
+#define VIRTIO_NET_GRO_MAX_FLOWS 8
+
+/* TCP flow being coalesced by software GRO */
+typedef struct VirtioNetGroFlow {
+    QTAILQ_ENTRY(VirtioNetGroFlow) next;
+    NetClientState *nc;
+    struct VirtIONetQueue *q; /* RX queue the flow is delivered to */
+    uint8_t *buf;           /* Ethernet frame, headers of the first segment */
+    size_t size;
+    uint16_t proto;         /* ETH_P_IP or ETH_P_IPV6 */
+    uint16_t l4_off;        /* offset of the TCP header in buf */
+    uint16_t payload_off;   /* offset of the TCP payload in buf */
+    uint16_t mss;           /* payload size of the first segment */
+    uint16_t segs;
+    uint32_t next_seq;
+} VirtioNetGroFlow;
+
 /* Maximum packet size we can receive from tap device: header + 64k */
 #define VIRTIO_NET_MAX_BUFSIZE (sizeof(struct virtio_net_hdr) + (64 * KiB))
 
@@ -164,6 +182,8 @@ typedef struct VirtIONetQueue {
     struct {
         VirtQueueElement *elem;
     } async_tx;
+    /* RX buffers filled but not yet flushed while receiving a batch */
+    unsigned int rx_pending;
     struct VirtIONet *n;
 } VirtIONetQueue;
 
@@ -186,6 +206,15 @@ struct VirtIONet {
     uint32_t rsc_timeout;
     uint8_t rsc4_enabled;
     uint8_t rsc6_enabled;
+    /*
+     * Software GRO for backends without vnet header, flows are lost in
+     * case of migration like RSC chains
+     */
+    bool rx_gro;
+    QTAILQ_HEAD(, VirtioNetGroFlow) gro_flows;
+    QTAILQ_HEAD(, VirtioNetGroFlow) gro_free;
+    unsigned int gro_nflows;
+    QEMUBH *gro_bh;
     uint8_t has_ufo;
     uint32_t mergeable_rx_bufs;
     uint8_t promisc;
@@ -71,6 +71,8 @@ typedef struct VirtQueueElement
     unsigned int in_num;
     /* Element has been processed (VIRTIO_F_IN_ORDER) */
     bool in_order_filled;
+    /* Element can be returned with virtqueue_recycle_element() */
+    bool pooled;
     hwaddr *in_addr;
     hwaddr *out_addr;
     struct iovec *in_sg;
@@ -276,6 +278,32 @@ void virtqueue_fill(VirtQueue *vq, const VirtQueueElement *elem,
 
 void virtqueue_map(VirtIODevice *vdev, VirtQueueElement *elem);
 void *virtqueue_pop(VirtQueue *vq, size_t sz);
+/**
+ * virtqueue_pop_batch:
+ * @vq: the virtqueue
+ * @sz: the size of each element, as for virtqueue_pop()
+ * @elems: array that receives the elements
+ * @max: maximum number of elements to pop
+ *
+ * Like calling virtqueue_pop() up to @max times, but for split rings
+ * the avail index is read and ordered against the descriptor reads only
+ * once for the whole batch.
+ *
+ * Returns: the number of elements stored in @elems
+ */
+unsigned int virtqueue_pop_batch(VirtQueue *vq, size_t sz, void **elems,
+                                 unsigned int max);
+/**
+ * virtqueue_recycle_element:
+ * @vq: the virtqueue @elem was popped from
+ * @elem: the element, which must not be used anymore
+ *
+ * Free @elem, keeping it around for a later virtqueue_pop() on @vq if
+ * possible.  Calling g_free() on an element is still fine, but misses
+ * the chance to reuse it.  The same threading rules as for
+ * virtqueue_push() apply.
+ */
+void virtqueue_recycle_element(VirtQueue *vq, void *elem);
 unsigned int virtqueue_drop_all(VirtQueue *vq);
 void *qemu_get_virtqueue_element(VirtIODevice *vdev, QEMUFile *f, size_t sz);
 void qemu_put_virtqueue_element(VirtIODevice *vdev, QEMUFile *f,
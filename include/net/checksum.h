@@ -31,6 +31,7 @@ uint16_t net_checksum_finish(uint32_t sum);
 uint16_t net_checksum_tcpudp(uint16_t length, uint16_t proto,
                              uint8_t *addrs, uint8_t *buf);
 void net_checksum_calculate(void *data, int length, int csum_flag);
+bool test_net_checksum_next_accel(void);
 
 static inline uint32_t
 net_checksum_add(int len, uint8_t *buf)
@@ -64,6 +65,20 @@ uint32_t net_checksum_add_iov(const struct iovec *iov,
                               uint32_t iov_off, uint32_t size,
                               uint32_t csum_offset);
 
+/**
+ * net_toeplitz_hash: compute a Toeplitz hash
+ *
+ * @key: hash key, at least @len + 4 bytes long
+ * @input: data to be hashed
+ * @len: length of @input
+ *
+ * Same result as net_toeplitz_add() starting from zero, but works on
+ * 32 bits at a time with carry-less multiplication, which is done in
+ * hardware on hosts that support it.
+ */
+uint32_t net_toeplitz_hash(const uint8_t *key, const uint8_t *input,
+                           size_t len);
+
 typedef struct toeplitz_key_st {
     uint32_t leftmost_32_bits;
     uint8_t *next_byte;
@@ -49,6 +49,7 @@ typedef int (NetLoad)(NetClientState *);
 typedef void (NetStop)(NetClientState *);
 typedef ssize_t (NetReceive)(NetClientState *, const uint8_t *, size_t);
 typedef ssize_t (NetReceiveIOV)(NetClientState *, const struct iovec *, int);
+typedef int (NetReceiveBatch)(NetClientState *, const NetPacketVec *, int);
 typedef void (NetCleanup) (NetClientState *);
 typedef void (LinkStatusChanged)(NetClientState *);
 typedef void (NetClientDestructor)(NetClientState *);
@@ -75,6 +76,12 @@ typedef struct NetClientInfo {
     size_t size;
     NetReceive *receive;
     NetReceiveIOV *receive_iov;
+    /*
+     * Optional.  Returns the number of leading packets consumed; a short
+     * count disables reception until the queue is flushed, as with a
+     * zero return from receive_iov.
+     */
+    NetReceiveBatch *receive_batch;
     NetCanReceive *can_receive;
     NetStart *start;
     NetLoad *load;
@@ -174,6 +181,9 @@ ssize_t qemu_sendv_packet(NetClientState *nc, const struct iovec *iov,
                           int iovcnt);
 ssize_t qemu_sendv_packet_async(NetClientState *nc, const struct iovec *iov,
                                 int iovcnt, NetPacketSent *sent_cb);
+int qemu_sendv_packet_batch_async(NetClientState *nc,
+                                  const NetPacketVec *pkts, int npkts,
+                                  NetPacketSent *sent_cb);
 ssize_t qemu_send_packet(NetClientState *nc, const uint8_t *buf, int size);
 ssize_t qemu_receive_packet(NetClientState *nc, const uint8_t *buf, int size);
 ssize_t qemu_send_packet_raw(NetClientState *nc, const uint8_t *buf, int size);
@@ -191,9 +191,13 @@ char *freq_to_str(uint64_t freq_hz);
  * Check if a buffer is all zeroes.
  */
 
+/* Buffers of at least this size are scanned with a cache-bypassing variant */
+#define BUFFER_IS_ZERO_LARGE  (64 * 1024)
+
 bool buffer_is_zero_ool(const void *vbuf, size_t len);
 bool buffer_is_zero_ge256(const void *vbuf, size_t len);
 bool test_buffer_is_zero_next_accel(void);
+bool test_buffer_is_zero_set_accel(unsigned index, unsigned index_large);
 
 static inline bool buffer_is_zero_sample3(const char *buf, size_t len)
 {
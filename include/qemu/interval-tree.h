@@ -96,4 +96,50 @@ IntervalTreeNode *interval_tree_iter_first(IntervalTreeRoot *root,
 IntervalTreeNode *interval_tree_iter_next(IntervalTreeNode *node,
                                           uint64_t start, uint64_t last);
 
+/*
+ * Interval tree node that also records the size of the largest interval
+ * in its subtree.  A tree must contain either only IntervalTreeNode or only
+ * IntervalTreeSizedNode; the iteration functions above work on both.
+ */
+typedef struct IntervalTreeSizedNode
+{
+    IntervalTreeNode itree;
+
+    uint64_t subtree_max_size;  /* Largest (last - start) in the subtree */
+} IntervalTreeSizedNode;
+
+/**
+ * interval_tree_sized_insert
+ * @node: node to insert,
+ * @root: root of the tree.
+ *
+ * Insert @node into @root, and rebalance.
+ */
+void interval_tree_sized_insert(IntervalTreeSizedNode *node,
+                                IntervalTreeRoot *root);
+
+/**
+ * interval_tree_sized_remove
+ * @node: node to remove,
+ * @root: root of the tree.
+ *
+ * Remove @node from @root, and rebalance.
+ */
+void interval_tree_sized_remove(IntervalTreeSizedNode *node,
+                                IntervalTreeRoot *root);
+
+/**
+ * interval_tree_sized_find_fit:
+ * @root: root of the tree,
+ * @start: the lowest location that may be used,
+ * @size: the number of locations wanted, minus one.
+ *
+ * Locate the node with the lowest start that contains the interval
+ * [MAX(node->start, @start), MAX(node->start, @start) + @size].
+ * Returns NULL if there is no such node.
+ */
+IntervalTreeSizedNode *interval_tree_sized_find_fit(IntervalTreeRoot *root,
+                                                    uint64_t start,
+                                                    uint64_t size);
+
 #endif /* QEMU_INTERVAL_TREE_H */
@@ -15,6 +15,7 @@
 #include "io/channel-socket.h"
 #include "io/channel-file.h"
 #include "io/net-listener.h"
+#include "qemu/event_notifier.h"
 #include "qapi/error.h"
 #include "standard-headers/linux/virtio_blk.h"
 
@@ -22,7 +23,8 @@
 typedef struct VuFdWatch {
     VuDev *vu_dev;
     int fd; /*kick fd*/
-    void *pvt;
+    EventNotifier notifier; /* wraps fd, for AioContext polling */
+    void *pvt; /* virtqueue index */
     vu_watch_cb cb;
     QTAILQ_ENTRY(VuFdWatch) next;
 } VuFdWatch;
@@ -63,6 +65,8 @@ bool vhost_user_server_start(VuServer *server,
 
 void vhost_user_server_stop(VuServer *server);
 
+void vhost_user_server_queue_notify(VuServer *server, VuVirtq *vq);
+
 void vhost_user_server_inc_in_flight(VuServer *server);
 void vhost_user_server_dec_in_flight(VuServer *server);
 bool vhost_user_server_has_in_flight(VuServer *server);
@@ -0,0 +1,44 @@
+/*
+ * Host implementations of guest library functions
+ *
+ * With -native-libc, well known string and memory functions found in the
+ * symbol table of the guest binary are not emulated.  The translator of a
+ * target that supports this calls native_call_lookup() for each guest pc
+ * and, on a match, emits a call to native_call_run() with the function
+ * arguments taken from the guest registers.  If that fails, for example
+ * because a buffer is not accessible, the guest code is run as usual.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef USER_NATIVE_CALL_H
+#define USER_NATIVE_CALL_H
+
+#include "user/abitypes.h"
+
+typedef enum NativeCall {
+    NATIVE_CALL_MEMCPY,
+    NATIVE_CALL_MEMMOVE,
+    NATIVE_CALL_MEMSET,
+    NATIVE_CALL_MEMCMP,
+    NATIVE_CALL_STRLEN,
+    NATIVE_CALL__MAX,
+} NativeCall;
+
+extern bool native_call_enabled;
+
+/* Note that guest function NAME starts at ADDR. */
+void native_call_register(const char *name, abi_ulong addr);
+
+/* Return the function starting at ADDR, or -1. */
+int native_call_lookup(abi_ulong addr);
+
+/*
+ * Run function ID with the given arguments, returning false if it must be
+ * emulated instead.
+ */
+bool native_call_run(int id, abi_ulong arg0, abi_ulong arg1, abi_ulong arg2,
+                     abi_ulong *ret);
+
+#endif
@@ -14,10 +14,12 @@
 #include "exec/translation-block.h"
 #include "exec/tswap.h"
 #include "user/guest-base.h"
+#include "user/native-call.h"
 #include "user-internals.h"
 #include "signal-common.h"
 #include "loader.h"
 #include "user-mmap.h"
+#include "vvar.h"
 #include "disas/disas.h"
 #include "qemu/bitops.h"
 #include "qemu/path.h"
@@ -56,6 +58,7 @@ typedef struct {
     unsigned reloc_count;
     unsigned sigreturn_ofs;
     unsigned rt_sigreturn_ofs;
+    unsigned vvar_ofs;
 } VdsoImageInfo;
 
 #define ELF_OSABI   ELFOSABI_SYSV
@@ -3582,7 +3585,7 @@ static void load_elf_image(const char *image_name, const ImageSource *src,
         info->end_data = info->end_code;
     }
 
-    if (qemu_log_enabled()) {
+    if (qemu_log_enabled() || native_call_enabled) {
         load_symbols(ehdr, src, load_bias);
     }
 
@@ -3676,6 +3679,11 @@ static void load_elf_vdso(struct image_info *info, const VdsoImageInfo *vdso)
     /* Remove write from VDSO segment. */
     target_mprotect(info->start_data, info->end_data - info->start_data,
                     PROT_READ | PROT_EXEC);
+
+    /* Hand the time data page over to QEMU, if present. */
+    if (vdso->vvar_ofs) {
+        vvar_init(load_addr + vdso->vvar_ofs);
+    }
 }
 
 static int symfind(const void *s0, const void *s1)
@@ -3730,7 +3738,7 @@ static void load_symbols(struct elfhdr *hdr, const ImageSource *src,
     char *strings = NULL;
     struct elf_sym *syms = NULL;
     struct elf_sym *new_syms;
-    uint64_t segsz;
+    uint64_t segsz, segsz_str;
 
     shnum = hdr->e_shnum;
     shdr = imgsrc_read_alloc(hdr->e_shoff, shnum * sizeof(struct elf_shdr),
@@ -3754,7 +3762,7 @@ static void load_symbols(struct elfhdr *hdr, const ImageSource *src,
  found:
     /* Now know where the strtab and symtab are.  Snarf them.  */
 
-    segsz = shdr[str_idx].sh_size;
+    segsz = segsz_str = shdr[str_idx].sh_size;
     strings = g_try_malloc(segsz);
     if (!strings) {
         goto give_up;
@@ -3795,6 +3803,14 @@ static void load_symbols(struct elfhdr *hdr, const ImageSource *src,
             syms[i].st_value &= ~(target_ulong)1;
 #endif
             syms[i].st_value += load_bias;
+            if (native_call_enabled && syms[i].st_name < segsz_str &&
+                memchr(strings + syms[i].st_name, 0,
+                       segsz_str - syms[i].st_name) &&
+                (ELF_ST_BIND(syms[i].st_info) == STB_GLOBAL ||
+                 ELF_ST_BIND(syms[i].st_info) == STB_WEAK)) {
+                native_call_register(strings + syms[i].st_name,
+                                     syms[i].st_value);
+            }
             i++;
         }
     }
@@ -33,9 +33,11 @@ static void output_reloc(FILE *outf, void *buf, void *loc)
 
 static const char *sigreturn_sym;
 static const char *rt_sigreturn_sym;
+static const char *vvar_sym;
 
 static unsigned sigreturn_addr;
 static unsigned rt_sigreturn_addr;
+static unsigned vvar_addr;
 
 #define N 32
 #define elfN(x)  elf32_##x
@@ -66,7 +68,7 @@ int main(int argc, char **argv)
     int ret = EXIT_FAILURE;
 
     while (1) {
-        int opt = getopt(argc, argv, "o:p:r:s:");
+        int opt = getopt(argc, argv, "o:p:r:s:v:");
         if (opt < 0) {
             break;
         }
@@ -83,10 +85,14 @@ int main(int argc, char **argv)
         case 's':
             sigreturn_sym = optarg;
             break;
+        case 'v':
+            vvar_sym = optarg;
+            break;
         default:
         usage:
             fprintf(stderr, "usage: [-p prefix] [-r rt-sigreturn-name] "
-                    "[-s sigreturn-name] -o output-file input-file\n");
+                    "[-s sigreturn-name] [-v vvar-name] "
+                    "-o output-file input-file\n");
             return EXIT_FAILURE;
         }
     }
@@ -192,6 +198,13 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
+    /* Without it the vvar page would silently never be set up. */
+    if (vvar_sym && !vvar_addr) {
+        fprintf(stderr, "%s: symbol %s not found, image out of date?\n",
+                inf_name, vvar_sym);
+        return EXIT_FAILURE;
+    }
+
     fprintf(outf, "};\n\n");   /* end vdso_relocs. */
 
     /*
@@ -215,6 +228,7 @@ int main(int argc, char **argv)
     fprintf(outf, "    .reloc_count = ARRAY_SIZE(%s_relocs),\n", prefix);
     fprintf(outf, "    .sigreturn_ofs = 0x%x,\n", sigreturn_addr);
     fprintf(outf, "    .rt_sigreturn_ofs = 0x%x,\n", rt_sigreturn_addr);
+    fprintf(outf, "    .vvar_ofs = 0x%x,\n", vvar_addr);
     fprintf(outf, "};\n");
 
     ret = EXIT_SUCCESS;
@@ -39,6 +39,7 @@
 #include "qemu/module.h"
 #include "qemu/plugin.h"
 #include "user/guest-base.h"
+#include "user/native-call.h"
 #include "user/page-protection.h"
 #include "exec/gdbstub.h"
 #include "gdbstub/user.h"
@@ -56,6 +57,7 @@
 #include "signal-common.h"
 #include "loader.h"
 #include "user-mmap.h"
+#include "vvar.h"
 #include "tcg/perf.h"
 #include "exec/page-vary.h"
 
@@ -147,6 +149,7 @@ void fork_start(void)
 {
     start_exclusive();
     mmap_fork_start();
+    vvar_fork_start();
     cpu_list_lock();
     qemu_plugin_user_prefork_lock();
     gdbserver_fork_start();
@@ -160,6 +163,7 @@ void fork_end(pid_t pid)
     fd_trans_postfork();
     qemu_plugin_user_postfork(child);
     mmap_fork_end(child);
+    vvar_fork_end(child);
     if (child) {
         CPUState *cpu, *next_cpu;
         /* Child processes created by fork() only have a single thread.
@@ -429,6 +433,11 @@ static void handle_arg_one_insn_per_tb(const char *arg)
     opt_one_insn_per_tb = true;
 }
 
+static void handle_arg_native_libc(const char *arg)
+{
+    native_call_enabled = true;
+}
+
 static void handle_arg_tb_size(const char *arg)
 {
     if (qemu_strtoul(arg, NULL, 0, &opt_tb_size)) {
@@ -528,6 +537,8 @@ static const struct qemu_argument arg_table[] = {
     {"one-insn-per-tb",
                    "QEMU_ONE_INSN_PER_TB",  false, handle_arg_one_insn_per_tb,
      "",           "run with one guest instruction per emulated TB"},
+    {"native-libc", "QEMU_NATIVE_LIBC", false, handle_arg_native_libc,
+     "",           "run guest memcpy, memset, strlen, ... natively"},
     {"tb-size",    "QEMU_TB_SIZE",     true,  handle_arg_tb_size,
      "size",       "TCG translation block cache size"},
     {"strace",     "QEMU_STRACE",      false, handle_arg_strace,
@@ -0,0 +1,147 @@
+/*
+ * Host implementations of guest library functions
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu.h"
+#include "user-internals.h"
+#include "user/native-call.h"
+
+/* Room for the functions of both the binary and its interpreter */
+#define NATIVE_CALL_ENTRIES (2 * NATIVE_CALL__MAX)
+
+typedef struct NativeCallEntry {
+    abi_ulong addr;
+    NativeCall id;
+} NativeCallEntry;
+
+bool native_call_enabled;
+
+static const char * const native_call_names[NATIVE_CALL__MAX] = {
+    [NATIVE_CALL_MEMCPY] = "memcpy",
+    [NATIVE_CALL_MEMMOVE] = "memmove",
+    [NATIVE_CALL_MEMSET] = "memset",
+    [NATIVE_CALL_MEMCMP] = "memcmp",
+    [NATIVE_CALL_STRLEN] = "strlen",
+};
+
+/* Written while loading the binaries, before any code is translated */
+static NativeCallEntry native_calls[NATIVE_CALL_ENTRIES];
+static int native_call_count;
+
+/* Functions that have been run on the host, for logging */
+static bool native_call_used[NATIVE_CALL__MAX];
+
+void native_call_register(const char *name, abi_ulong addr)
+{
+    int i;
+
+    if (native_call_count == NATIVE_CALL_ENTRIES) {
+        return;
+    }
+    for (i = 0; i < NATIVE_CALL__MAX; i++) {
+        if (strcmp(name, native_call_names[i]) == 0) {
+            native_calls[native_call_count].addr = addr;
+            native_calls[native_call_count].id = i;
+            native_call_count++;
+            qemu_log_mask(CPU_LOG_PAGE, "native call %s at 0x"
+                          TARGET_ABI_FMT_lx "\n", name, addr);
+            return;
+        }
+    }
+}
+
+int native_call_lookup(abi_ulong addr)
+{
+    int i;
+
+    for (i = 0; i < native_call_count; i++) {
+        if (native_calls[i].addr == addr) {
+            return native_calls[i].id;
+        }
+    }
+    return -1;
+}
+
+/*
+ * The buffers are locked as for a syscall, which checks the guest page
+ * protection and invalidates translated code in pages that are written.
+ */
+static bool native_call_host(int id, abi_ulong arg0, abi_ulong arg1,
+                             abi_ulong arg2, abi_ulong *ret)
+{
+    void *d, *s;
+    ssize_t len;
+
+    switch (id) {
+    case NATIVE_CALL_MEMCPY:
+    case NATIVE_CALL_MEMMOVE:
+        d = lock_user(VERIFY_WRITE, arg0, arg2, 0);
+        if (!d) {
+            return false;
+        }
+        s = lock_user(VERIFY_READ, arg1, arg2, 1);
+        if (!s) {
+            unlock_user(d, arg0, 0);
+            return false;
+        }
+        memmove(d, s, arg2);
+        unlock_user(s, arg1, 0);
+        unlock_user(d, arg0, arg2);
+        *ret = arg0;
+        return true;
+
+    case NATIVE_CALL_MEMSET:
+        d = lock_user(VERIFY_WRITE, arg0, arg2, 0);
+        if (!d) {
+            return false;
+        }
+        memset(d, arg1, arg2);
+        unlock_user(d, arg0, arg2);
+        *ret = arg0;
+        return true;
+
+    case NATIVE_CALL_MEMCMP:
+        d = lock_user(VERIFY_READ, arg0, arg2, 1);
+        if (!d) {
+            return false;
+        }
+        s = lock_user(VERIFY_READ, arg1, arg2, 1);
+        if (!s) {
+            unlock_user(d, arg0, 0);
+            return false;
+        }
+        *ret = (abi_long)memcmp(d, s, arg2);
+        unlock_user(s, arg1, 0);
+        unlock_user(d, arg0, 0);
+        return true;
+
+    case NATIVE_CALL_STRLEN:
+        len = target_strlen(arg0);
+        if (len < 0) {
+            return false;
+        }
+        *ret = len;
+        return true;
+
+    default:
+        g_assert_not_reached();
+    }
+}
+
+bool native_call_run(int id, abi_ulong arg0, abi_ulong arg1, abi_ulong arg2,
+                     abi_ulong *ret)
+{
+    if (!native_call_host(id, arg0, arg1, arg2, ret)) {
+        return false;
+    }
+    if (unlikely(!qatomic_read(&native_call_used[id]))) {
+        qatomic_set(&native_call_used[id], true);
+        qemu_log_mask(CPU_LOG_PAGE, "native call %s run on the host\n",
+                      native_call_names[id]);
+    }
+    return true;
+}
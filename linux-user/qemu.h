@@ -157,6 +157,18 @@ struct TaskState {
      * from multiple threads.)
      */
     int signal_pending;
+    /*
+     * Nonzero if all host signals except SIGSEGV and SIGBUS are known to
+     * be blocked, as done by block_signals() (which blocks those two as
+     * well) and host_signal_handler() (which cannot), so that
+     * process_pending_signals() need not block them again.  It then runs
+     * with SIGSEGV and SIGBUS possibly unblocked; it does not fault on
+     * guest memory, and an asynchronous SIGSEGV or SIGBUS is only queued.
+     * Like signal_pending it is written from a signal handler, so use
+     * qatomic_read/qatomic_set; it may be stale zero but never stale
+     * nonzero.
+     */
+    int sigmask_blocked;
 
     /* This thread's sigaltstack, if it has one */
     struct target_sigaltstack sigaltstack_used;
@@ -189,10 +189,47 @@ int block_signals(void)
      */
     sigfillset(&set);
     sigprocmask(SIG_SETMASK, &set, 0);
+    qatomic_set(&ts->sigmask_blocked, 1);
 
     return qatomic_xchg(&ts->signal_pending, 1);
 }
 
+/*
+ * Return true if a queued signal can be delivered with the current guest
+ * signal mask, so that process_pending_signals() has work to do.
+ */
+static bool signal_deliverable(TaskState *ts)
+{
+    int sig;
+
+    if (ts->sync_signal.pending) {
+        return true;
+    }
+    for (sig = 1; sig <= TARGET_NSIG; sig++) {
+        if (ts->sigtab[sig - 1].pending &&
+            !sigismember(&ts->signal_mask, target_to_host_signal_table[sig])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Give the host the guest signal mask, except that SIGSEGV and SIGBUS
+ * are never blocked while running guest code.  Called with all host
+ * signals blocked; the unblocked ones may be taken right away.
+ */
+static void unblock_signals(TaskState *ts)
+{
+    sigset_t set = ts->signal_mask;
+
+    sigdelset(&set, SIGSEGV);
+    sigdelset(&set, SIGBUS);
+    qatomic_set(&ts->signal_pending, 0);
+    sigprocmask(SIG_SETMASK, &set, 0);
+    qatomic_set(&ts->sigmask_blocked, 0);
+}
+
 /* Wrapper for sigprocmask function
  * Emulates a sigprocmask in a safe way for the guest. Note that set and oldset
  * are host signal set, not guest ones. Returns -QEMU_ERESTARTSYS if
@@ -209,33 +246,54 @@ int do_sigprocmask(int how, const sigset_t *set, sigset_t *oldset)
     }
 
     if (set) {
+        sigset_t mask = ts->signal_mask;
         int i;
 
-        if (block_signals()) {
-            return -QEMU_ERESTARTSYS;
-        }
-
         switch (how) {
         case SIG_BLOCK:
-            sigorset(&ts->signal_mask, &ts->signal_mask, set);
+            sigorset(&mask, &mask, set);
             break;
         case SIG_UNBLOCK:
             for (i = 1; i <= NSIG; ++i) {
                 if (sigismember(set, i)) {
-                    sigdelset(&ts->signal_mask, i);
+                    sigdelset(&mask, i);
                 }
             }
             break;
         case SIG_SETMASK:
-            ts->signal_mask = *set;
+            mask = *set;
             break;
         default:
             g_assert_not_reached();
         }
 
         /* Silently ignore attempts to change blocking status of KILL or STOP */
-        sigdelset(&ts->signal_mask, SIGKILL);
-        sigdelset(&ts->signal_mask, SIGSTOP);
+        sigdelset(&mask, SIGKILL);
+        sigdelset(&mask, SIGSTOP);
+
+        /*
+         * Runtimes often set the mask they already have, which needs no
+         * host syscall at all.  A signal that is already pending is then
+         * delivered after this syscall with the same mask, as it would be
+         * after a restart.
+         */
+        if (!memcmp(&mask, &ts->signal_mask, sizeof(mask))) {
+            return 0;
+        }
+
+        if (block_signals()) {
+            return -QEMU_ERESTARTSYS;
+        }
+        ts->signal_mask = mask;
+
+        /*
+         * Unless the new mask lets a queued signal through, install it
+         * now rather than having process_pending_signals() block and
+         * unblock the host signals again.
+         */
+        if (!signal_deliverable(ts)) {
+            unblock_signals(ts);
+        }
     }
     return 0;
 }
@@ -1115,6 +1173,7 @@ static void host_signal_handler(int host_sig, siginfo_t *info, void *puc)
     memset(sigmask, 0xff, SIGSET_T_SIZE);
     sigdelset(sigmask, SIGSEGV);
     sigdelset(sigmask, SIGBUS);
+    qatomic_set(&ts->sigmask_blocked, 1);
 
     /* interrupt the virtual CPU as soon as possible */
     cpu_exit(thread_cpu);
@@ -1361,8 +1420,12 @@ void process_pending_signals(CPUArchState *cpu_env)
     sigset_t *blocked_set;
 
     while (qatomic_read(&ts->signal_pending)) {
-        sigfillset(&set);
-        sigprocmask(SIG_SETMASK, &set, 0);
+        /* Skip the syscall if a signal handler already blocked them */
+        if (!qatomic_read(&ts->sigmask_blocked)) {
+            sigfillset(&set);
+            sigprocmask(SIG_SETMASK, &set, 0);
+            qatomic_set(&ts->sigmask_blocked, 1);
+        }
 
     restart_scan:
         sig = ts->sync_signal.pending;
@@ -1403,12 +1466,8 @@ void process_pending_signals(CPUArchState *cpu_env)
          * of unblocking might cause us to take another host signal which
          * will set signal_pending again).
          */
-        qatomic_set(&ts->signal_pending, 0);
         ts->in_sigsuspend = 0;
-        set = ts->signal_mask;
-        sigdelset(&set, SIGSEGV);
-        sigdelset(&set, SIGBUS);
-        sigprocmask(SIG_SETMASK, &set, 0);
+        unblock_signals(ts);
     }
     ts->in_sigsuspend = 0;
 }
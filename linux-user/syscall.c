@@ -147,6 +147,7 @@
 #include "special-errno.h"
 #include "qapi/error.h"
 #include "fd-trans.h"
+#include "vvar.h"
 #include "user/cpu_loop.h"
 
 #ifndef CLONE_IO
@@ -3015,12 +3016,41 @@ static void target_to_host_low_high(abi_ulong tlow,
     *hhigh = (off >> HOST_LONG_BITS / 2) >> HOST_LONG_BITS / 2;
 }
 
+/*
+ * Host iovec arrays for up to IOVEC_SCRATCH_COUNT segments come from a
+ * per-thread array instead of the heap.  A thread has at most one vector
+ * locked at a time, but fall back to the heap if that ever changes.
+ */
+#define IOVEC_SCRATCH_COUNT 16
+static __thread struct iovec iovec_scratch[IOVEC_SCRATCH_COUNT];
+static __thread bool iovec_scratch_busy;
+
+static struct iovec *alloc_iovec(abi_ulong count)
+{
+    if (count <= IOVEC_SCRATCH_COUNT && !iovec_scratch_busy) {
+        iovec_scratch_busy = true;
+        memset(iovec_scratch, 0, count * sizeof(struct iovec));
+        return iovec_scratch;
+    }
+    return g_try_new0(struct iovec, count);
+}
+
+static void free_iovec(struct iovec *vec)
+{
+    if (vec == iovec_scratch) {
+        iovec_scratch_busy = false;
+    } else {
+        g_free(vec);
+    }
+}
+
 static struct iovec *lock_iovec(int type, abi_ulong target_addr,
                                 abi_ulong count, int copy)
 {
     struct target_iovec *target_vec;
     struct iovec *vec;
     abi_ulong total_len, max_len;
+    abi_ulong ok_start = 1, ok_last = 0;
     int i;
     int err = 0;
     bool bad_address = false;
@@ -3034,7 +3064,7 @@ static struct iovec *lock_iovec(int type, abi_ulong target_addr,
         return NULL;
     }
 
-    vec = g_try_new0(struct iovec, count);
+    vec = alloc_iovec(count);
     if (vec == NULL) {
         errno = ENOMEM;
         return NULL;
@@ -3063,7 +3093,27 @@ static struct iovec *lock_iovec(int type, abi_ulong target_addr,
             /* Zero length pointer is ignored.  */
             vec[i].iov_base = 0;
         } else {
+#ifndef CONFIG_DEBUG_REMAP
+            /*
+             * Segments often share pages, e.g. a header and payload in
+             * the same buffer.  Pages already checked by the previous
+             * segment need not be looked up again.
+             */
+            abi_ulong ubase = cpu_untagged_addr(thread_cpu, base);
+
+            if (ubase >= ok_start && ubase + len - 1 <= ok_last &&
+                ubase + len - 1 >= ubase) {
+                vec[i].iov_base = g2h_untagged(ubase);
+            } else {
+                vec[i].iov_base = lock_user(type, base, len, copy);
+                if (vec[i].iov_base) {
+                    ok_start = ubase & TARGET_PAGE_MASK;
+                    ok_last = (ubase + len - 1) | ~TARGET_PAGE_MASK;
+                }
+            }
+#else
             vec[i].iov_base = lock_user(type, base, len, copy);
+#endif
             /* If the first buffer pointer is bad, this is a fault.  But
              * subsequent bad buffers will result in a partial write; this
              * is realized by filling the vector with null pointers and
@@ -3098,7 +3148,7 @@ static struct iovec *lock_iovec(int type, abi_ulong target_addr,
     }
     unlock_user(target_vec, target_addr, 0);
  fail2:
-    g_free(vec);
+    free_iovec(vec);
     errno = err;
     return NULL;
 }
@@ -3106,6 +3156,7 @@ static struct iovec *lock_iovec(int type, abi_ulong target_addr,
 static void unlock_iovec(struct iovec *vec, abi_ulong target_addr,
                          abi_ulong count, int copy)
 {
+#ifdef CONFIG_DEBUG_REMAP
     struct target_iovec *target_vec;
     int i;
 
@@ -3122,8 +3173,10 @@ static void unlock_iovec(struct iovec *vec, abi_ulong target_addr,
         }
         unlock_user(target_vec, target_addr, 0);
     }
+#endif
+    /* Otherwise unlock_user() is a no-op, and vec points at guest memory */
 
-    g_free(vec);
+    free_iovec(vec);
 }
 
 static inline int target_to_host_sock_type(int *type)
@@ -10472,9 +10525,19 @@ static abi_long do_syscall1(CPUArchState *cpu_env, int num, abi_long arg1,
         {
             struct timeval tv;
             struct timezone tz;
+            struct timespec ts;
+            /* Stay consistent with the vdso. */
+            bool have_tv = vvar_clock_gettime(CLOCK_REALTIME, &ts);
 
-            ret = get_errno(gettimeofday(&tv, &tz));
+            ret = 0;
+            if (!have_tv || arg2) {
+                ret = get_errno(gettimeofday(&tv, &tz));
+            }
             if (!is_error(ret)) {
+                if (have_tv) {
+                    tv.tv_sec = ts.tv_sec;
+                    tv.tv_usec = ts.tv_nsec / 1000;
+                }
                 if (arg1 && copy_to_user_timeval(arg1, &tv)) {
                     return -TARGET_EFAULT;
                 }
@@ -12846,7 +12909,11 @@ static abi_long do_syscall1(CPUArchState *cpu_env, int num, abi_long arg1,
     case TARGET_NR_clock_gettime:
     {
         struct timespec ts;
-        ret = get_errno(clock_gettime(arg1, &ts));
+        if (vvar_clock_gettime(arg1, &ts)) {
+            ret = 0;
+        } else {
+            ret = get_errno(clock_gettime(arg1, &ts));
+        }
         if (!is_error(ret)) {
             ret = host_to_target_timespec(arg2, &ts);
         }
@@ -12857,7 +12924,11 @@ static abi_long do_syscall1(CPUArchState *cpu_env, int num, abi_long arg1,
     case TARGET_NR_clock_gettime64:
     {
         struct timespec ts;
-        ret = get_errno(clock_gettime(arg1, &ts));
+        if (vvar_clock_gettime(arg1, &ts)) {
+            ret = 0;
+        } else {
+            ret = get_errno(clock_gettime(arg1, &ts));
+        }
         if (!is_error(ret)) {
             ret = host_to_target_timespec64(arg2, &ts);
         }
@@ -13897,6 +13968,121 @@ static abi_long do_syscall1(CPUArchState *cpu_env, int num, abi_long arg1,
     return ret;
 }
 
+#if TARGET_ABI_BITS == 64 && HOST_LONG_BITS == 64
+/*
+ * Syscalls whose arguments and result are plain integers with the same
+ * meaning for guest and host, and whose effects QEMU does not track, are
+ * issued directly without going through do_syscall1().  Blocking ones
+ * are safe because safe_syscall() is used for all of them.  Entries
+ * hold the host syscall number plus one, so that unused slots are 0.
+ */
+#define PASSTHROUGH(name) [TARGET_NR_##name] = __NR_##name + 1
+
+static const uint16_t syscall_passthrough[] = {
+#if defined(TARGET_NR_getpid) && defined(__NR_getpid)
+    PASSTHROUGH(getpid),
+#endif
+#if defined(TARGET_NR_getppid) && defined(__NR_getppid)
+    PASSTHROUGH(getppid),
+#endif
+#if defined(TARGET_NR_gettid) && defined(__NR_gettid)
+    PASSTHROUGH(gettid),
+#endif
+#if defined(TARGET_NR_getpgrp) && defined(__NR_getpgrp)
+    PASSTHROUGH(getpgrp),
+#endif
+#if defined(TARGET_NR_getpgid) && defined(__NR_getpgid)
+    PASSTHROUGH(getpgid),
+#endif
+#if defined(TARGET_NR_getsid) && defined(__NR_getsid)
+    PASSTHROUGH(getsid),
+#endif
+#if defined(TARGET_NR_setpgid) && defined(__NR_setpgid)
+    PASSTHROUGH(setpgid),
+#endif
+#if defined(TARGET_NR_setsid) && defined(__NR_setsid)
+    PASSTHROUGH(setsid),
+#endif
+#if defined(TARGET_NR_umask) && defined(__NR_umask)
+    PASSTHROUGH(umask),
+#endif
+#if defined(TARGET_NR_sched_yield) && defined(__NR_sched_yield)
+    PASSTHROUGH(sched_yield),
+#endif
+#if defined(TARGET_NR_sched_get_priority_max) && \
+    defined(__NR_sched_get_priority_max)
+    PASSTHROUGH(sched_get_priority_max),
+#endif
+#if defined(TARGET_NR_sched_get_priority_min) && \
+    defined(__NR_sched_get_priority_min)
+    PASSTHROUGH(sched_get_priority_min),
+#endif
+#if defined(TARGET_NR_fsync) && defined(__NR_fsync)
+    PASSTHROUGH(fsync),
+#endif
+#if defined(TARGET_NR_fdatasync) && defined(__NR_fdatasync)
+    PASSTHROUGH(fdatasync),
+#endif
+#if defined(TARGET_NR_sync) && defined(__NR_sync)
+    PASSTHROUGH(sync),
+#endif
+#if defined(TARGET_NR_syncfs) && defined(__NR_syncfs)
+    PASSTHROUGH(syncfs),
+#endif
+#if defined(TARGET_NR_flock) && defined(__NR_flock)
+    PASSTHROUGH(flock),
+#endif
+#if defined(TARGET_NR_fchdir) && defined(__NR_fchdir)
+    PASSTHROUGH(fchdir),
+#endif
+#if defined(TARGET_NR_fchmod) && defined(__NR_fchmod)
+    PASSTHROUGH(fchmod),
+#endif
+#if defined(TARGET_NR_ftruncate) && defined(__NR_ftruncate)
+    PASSTHROUGH(ftruncate),
+#endif
+#if defined(TARGET_NR_lseek) && defined(__NR_lseek)
+    PASSTHROUGH(lseek),
+#endif
+#if defined(TARGET_NR_listen) && defined(__NR_listen)
+    PASSTHROUGH(listen),
+#endif
+#if defined(TARGET_NR_shutdown) && defined(__NR_shutdown)
+    PASSTHROUGH(shutdown),
+#endif
+#if defined(TARGET_NR_alarm) && defined(__NR_alarm)
+    PASSTHROUGH(alarm),
+#endif
+#if defined(TARGET_NR_munlockall) && defined(__NR_munlockall)
+    PASSTHROUGH(munlockall),
+#endif
+#if defined(TARGET_NR_ioprio_get) && defined(__NR_ioprio_get)
+    PASSTHROUGH(ioprio_get),
+#endif
+#if defined(TARGET_NR_ioprio_set) && defined(__NR_ioprio_set)
+    PASSTHROUGH(ioprio_set),
+#endif
+#if defined(TARGET_NR_inotify_rm_watch) && defined(__NR_inotify_rm_watch)
+    PASSTHROUGH(inotify_rm_watch),
+#endif
+};
+
+#undef PASSTHROUGH
+
+static inline int syscall_passthrough_nr(int num)
+{
+    if (num < 0 || num >= ARRAY_SIZE(syscall_passthrough)) {
+        return -1;
+    }
+    return syscall_passthrough[num] - 1;
+}
+#else
+static inline int syscall_passthrough_nr(int num)
+{
+    return -1;
+}
+#endif
+
 abi_long do_syscall(CPUArchState *cpu_env, int num, abi_long arg1,
                     abi_long arg2, abi_long arg3, abi_long arg4,
                     abi_long arg5, abi_long arg6, abi_long arg7,
@@ -13904,6 +14090,7 @@ abi_long do_syscall(CPUArchState *cpu_env, int num, abi_long arg1,
 {
     CPUState *cpu = env_cpu(cpu_env);
     abi_long ret;
+    int host_nr;
 
 #ifdef DEBUG_ERESTARTSYS
     /* Debug-only code for exercising the syscall-restart code paths
@@ -13926,8 +14113,14 @@ abi_long do_syscall(CPUArchState *cpu_env, int num, abi_long arg1,
         print_syscall(cpu_env, num, arg1, arg2, arg3, arg4, arg5, arg6);
     }
 
-    ret = do_syscall1(cpu_env, num, arg1, arg2, arg3, arg4,
-                      arg5, arg6, arg7, arg8);
+    host_nr = syscall_passthrough_nr(num);
+    if (host_nr >= 0) {
+        ret = get_errno(safe_syscall(host_nr, arg1, arg2, arg3,
+                                     arg4, arg5, arg6));
+    } else {
+        ret = do_syscall1(cpu_env, num, arg1, arg2, arg3, arg4,
+                          arg5, arg6, arg7, arg8);
+    }
 
     if (unlikely(qemu_loglevel_mask(LOG_STRACE))) {
         print_syscall_ret(cpu_env, num, ret, arg1, arg2,
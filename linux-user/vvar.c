@@ -0,0 +1,290 @@
+/*
+ * Time data page shared with the guest vdso
+ *
+ * The vdso reads the guest time counter, which in user mode is
+ * cpu_get_host_ticks(), and converts it to CLOCK_REALTIME or
+ * CLOCK_MONOTONIC with the base time and tick rate published here.
+ * The data is refreshed whenever the guest falls back to the syscall,
+ * which the vdso does once the published base is VVAR_MAX_NS old.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/host-utils.h"
+#include "qemu/seqlock.h"
+#include "qemu/timer.h"
+#include "exec/tswap.h"
+#include "qemu.h"
+#include "vvar.h"
+
+/* Measure the tick rate over at least this long before publishing. */
+#define VVAR_CALIBRATE_NS   (10 * SCALE_MS)
+/* Let the vdso extrapolate from the base for at most this long. */
+#define VVAR_MAX_NS         (10 * SCALE_MS)
+/* Smaller steps back in CLOCK_REALTIME are smoothed over. */
+#define VVAR_MAX_SLEW_NS    SCALE_MS
+
+typedef struct {
+    uint32_t seq;
+    uint32_t pad;
+    uint64_t cycle_last;
+    uint64_t mult;
+    uint64_t mult_frac;
+    uint64_t max_cycles;
+    uint64_t realtime[2];
+    uint64_t monotonic[2];
+} VvarPage;
+
+QEMU_BUILD_BUG_ON(offsetof(VvarPage, seq) != VVAR_SEQ);
+QEMU_BUILD_BUG_ON(offsetof(VvarPage, cycle_last) != VVAR_CYCLE_LAST);
+QEMU_BUILD_BUG_ON(offsetof(VvarPage, mult) != VVAR_MULT);
+QEMU_BUILD_BUG_ON(offsetof(VvarPage, mult_frac) != VVAR_MULT_FRAC);
+QEMU_BUILD_BUG_ON(offsetof(VvarPage, max_cycles) != VVAR_MAX_CYCLES);
+QEMU_BUILD_BUG_ON(offsetof(VvarPage, realtime) != VVAR_REALTIME);
+QEMU_BUILD_BUG_ON(offsetof(VvarPage, monotonic) != VVAR_MONOTONIC);
+QEMU_BUILD_BUG_ON(sizeof(VvarPage) != VVAR_SIZE);
+
+/* What the page holds, in host byte order. */
+typedef struct {
+    bool valid;
+    uint64_t ticks, mult, frac, max;
+    int64_t mono, real;
+} VvarState;
+
+/* Writable view of the guest page, NULL if not in use. */
+static VvarPage *vvar_page;
+static abi_ulong vvar_addr;
+static uint32_t vvar_seq;
+
+/*
+ * vvar_lock serializes updates; vvar_cur is written under vvar_sl as
+ * well, so that readers that find it recent enough need no lock.
+ */
+static pthread_mutex_t vvar_lock = PTHREAD_MUTEX_INITIALIZER;
+static QemuSeqLock vvar_sl;
+static VvarState vvar_cur;
+
+/* Start of the tick rate measurement. */
+static int64_t cal_ticks, cal_ns;
+
+static uint64_t vvar_scale(const VvarState *s, uint64_t delta)
+{
+    uint64_t lo, hi;
+
+    mulu64(&lo, &hi, delta, s->frac);
+    return delta * s->mult + hi;
+}
+
+/* Nanoseconds the vdso may have added to the base by now. */
+static uint64_t vvar_elapsed(const VvarState *s, int64_t ticks)
+{
+    int64_t delta = ticks - s->ticks;
+
+    return delta > 0 ? vvar_scale(s, MIN((uint64_t)delta, s->max)) : 0;
+}
+
+/* Return true if @s is missing or due for a refresh. */
+static bool vvar_stale(const VvarState *s)
+{
+    return !s->valid || cpu_get_host_ticks() - s->ticks >= s->max / 2;
+}
+
+static void vvar_sample(int64_t *ticks, int64_t *mono, int64_t *real)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    *mono = ts.tv_sec * NANOSECONDS_PER_SECOND + ts.tv_nsec;
+    *ticks = cpu_get_host_ticks();
+    clock_gettime(CLOCK_REALTIME, &ts);
+    *real = ts.tv_sec * NANOSECONDS_PER_SECOND + ts.tv_nsec;
+}
+
+static void vvar_publish(const VvarState *s)
+{
+    VvarPage *p = vvar_page;
+
+    qatomic_set(&p->seq, tswap32(++vvar_seq));
+    smp_wmb();
+    p->cycle_last = tswap64(s->ticks);
+    p->mult = tswap64(s->mult);
+    p->mult_frac = tswap64(s->frac);
+    p->max_cycles = tswap64(s->max);
+    p->realtime[0] = tswap64(s->real / NANOSECONDS_PER_SECOND);
+    p->realtime[1] = tswap64(s->real % NANOSECONDS_PER_SECOND);
+    p->monotonic[0] = tswap64(s->mono / NANOSECONDS_PER_SECOND);
+    p->monotonic[1] = tswap64(s->mono % NANOSECONDS_PER_SECOND);
+    smp_wmb();
+    qatomic_set(&p->seq, tswap32(++vvar_seq));
+}
+
+/* Called with vvar_lock held. */
+static void vvar_update(void)
+{
+    const VvarState *cur = &vvar_cur;
+    VvarState next = { .valid = true };
+    int64_t ticks, mono, real, last, ahead = 0;
+    uint64_t lo, hi, dticks, dns;
+
+    if (!vvar_stale(cur)) {
+        return;
+    }
+
+    vvar_sample(&ticks, &mono, &real);
+    if (mono - cal_ns < VVAR_CALIBRATE_NS || ticks <= cal_ticks) {
+        return;
+    }
+    dticks = ticks - cal_ticks;
+    dns = mono - cal_ns;
+
+    /*
+     * Never go back behind what the vdso may already have returned.
+     * CLOCK_REALTIME can be set, so only smooth over small differences.
+     */
+    if (cur->valid) {
+        last = cur->mono + vvar_elapsed(cur, ticks);
+        if (last > mono) {
+            ahead = last - mono;
+            mono = last;
+        }
+        last = cur->real + vvar_elapsed(cur, ticks);
+        if (real < last && last - real < VVAR_MAX_SLEW_NS) {
+            real = last;
+        }
+    }
+
+    /* Bound the extrapolation to VVAR_MAX_NS at the measured rate. */
+    mulu64(&lo, &hi, VVAR_MAX_NS, dticks);
+    divu128(&lo, &hi, dns);
+    next.max = lo;
+
+    /* Run slow while CLOCK_MONOTONIC catches up with us. */
+    if (ahead) {
+        mulu64(&lo, &hi, dns, VVAR_MAX_NS - MIN(ahead, VVAR_MAX_NS / 2));
+        divu128(&lo, &hi, VVAR_MAX_NS);
+        dns = lo;
+    }
+
+    /* Nanoseconds per tick, as 64.64 fixed point. */
+    lo = 0;
+    hi = dns;
+    divu128(&lo, &hi, dticks);
+    next.mult = hi;
+    next.frac = lo;
+
+    next.ticks = ticks;
+    next.mono = mono;
+    next.real = real;
+
+    seqlock_write_begin(&vvar_sl);
+    vvar_cur = next;
+    seqlock_write_end(&vvar_sl);
+    vvar_publish(&next);
+}
+
+static bool vvar_map(void)
+{
+    void *host = g2h_untagged(vvar_addr);
+    void *p;
+
+    /*
+     * Alias a shared page over the guest one, keeping a writable view
+     * of it for ourselves; the guest only gets to read it.
+     */
+    p = mmap(NULL, TARGET_PAGE_SIZE, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    if (mremap(p, 0, TARGET_PAGE_SIZE, MREMAP_MAYMOVE | MREMAP_FIXED,
+               host) == MAP_FAILED ||
+        mprotect(host, TARGET_PAGE_SIZE, PROT_READ) != 0) {
+        munmap(p, TARGET_PAGE_SIZE);
+        return false;
+    }
+    vvar_page = p;
+    return true;
+}
+
+void vvar_init(abi_ulong addr)
+{
+    int64_t real;
+
+    /* The page has to be mapped on its own. */
+    if (qemu_real_host_page_size() != TARGET_PAGE_SIZE) {
+        return;
+    }
+
+    seqlock_init(&vvar_sl);
+    vvar_addr = addr;
+    if (vvar_map()) {
+        vvar_sample(&cal_ticks, &cal_ns, &real);
+    }
+}
+
+void vvar_fork_start(void)
+{
+    pthread_mutex_lock(&vvar_lock);
+}
+
+void vvar_fork_end(bool child)
+{
+    VvarPage *old = vvar_page;
+
+    if (!child) {
+        pthread_mutex_unlock(&vvar_lock);
+        return;
+    }
+
+    pthread_mutex_init(&vvar_lock, NULL);
+    if (!old) {
+        return;
+    }
+
+    /*
+     * The page is still shared with the parent, which keeps updating
+     * it.  Give the child its own, to be filled in on the first time
+     * syscall; failing that, leave the updates to the parent.
+     */
+    vvar_page = NULL;
+    seqlock_init(&vvar_sl);
+    vvar_cur.valid = false;
+    vvar_seq = 0;
+    if (vvar_map()) {
+        munmap(old, TARGET_PAGE_SIZE);
+    }
+}
+
+bool vvar_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+    VvarState s;
+    unsigned start;
+    int64_t ns;
+
+    if (!vvar_page || (clk != CLOCK_REALTIME && clk != CLOCK_MONOTONIC)) {
+        return false;
+    }
+
+    do {
+        start = seqlock_read_begin(&vvar_sl);
+        s = vvar_cur;
+    } while (seqlock_read_retry(&vvar_sl, start));
+
+    if (vvar_stale(&s)) {
+        pthread_mutex_lock(&vvar_lock);
+        vvar_update();
+        s = vvar_cur;
+        pthread_mutex_unlock(&vvar_lock);
+        if (!s.valid) {
+            return false;
+        }
+    }
+
+    /* Use the vdso's arithmetic, so that the two agree. */
+    ns = clk == CLOCK_REALTIME ? s.real : s.mono;
+    ns += vvar_elapsed(&s, cpu_get_host_ticks());
+    ts->tv_sec = ns / NANOSECONDS_PER_SECOND;
+    ts->tv_nsec = ns % NANOSECONDS_PER_SECOND;
+    return true;
+}
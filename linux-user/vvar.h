@@ -0,0 +1,49 @@
+/*
+ * vvar.h: time data page shared with the guest vdso
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef LINUX_USER_VVAR_H
+#define LINUX_USER_VVAR_H
+
+/*
+ * Layout of the page, also included by the vdso assembly.  All fields
+ * are in guest byte order.  The vdso computes
+ *
+ *   ns = base_nsec + delta * mult + ((delta * mult_frac) >> 64)
+ *
+ * with delta = time counter - cycle_last, and must fall back to the
+ * syscall when delta >= max_cycles.  Writers make seq odd while they
+ * update the page.
+ */
+#define VVAR_SEQ                0       /* uint32_t */
+#define VVAR_CYCLE_LAST         8
+#define VVAR_MULT               16
+#define VVAR_MULT_FRAC          24
+#define VVAR_MAX_CYCLES         32
+#define VVAR_REALTIME           40      /* sec, nsec */
+#define VVAR_MONOTONIC          56      /* sec, nsec */
+#define VVAR_SIZE               72
+
+#ifndef __ASSEMBLER__
+
+/*
+ * Take over the page at @addr, which the vdso has just been loaded into,
+ * and start publishing time data in it.  The vdso keeps using syscalls
+ * if the page cannot be set up.
+ */
+void vvar_init(abi_ulong addr);
+
+/* Hold off updates across fork, and give the child its own page. */
+void vvar_fork_start(void);
+void vvar_fork_end(bool child);
+
+/*
+ * Read @clk consistently with the vdso, refreshing the page as needed.
+ * Return false if @clk is not published or the page is not in use.
+ */
+bool vvar_clock_gettime(clockid_t clk, struct timespec *ts);
+
+#endif /* __ASSEMBLER__ */
+#endif /* LINUX_USER_VVAR_H */
@@ -142,10 +142,11 @@ static void af_xdp_writable(void *opaque)
     qemu_flush_queued_packets(&s->nc);
 }
 
-static ssize_t af_xdp_receive(NetClientState *nc,
-                              const uint8_t *buf, size_t size)
+static ssize_t af_xdp_receive_iov(NetClientState *nc,
+                                  const struct iovec *iov, int iovcnt)
 {
     AFXDPState *s = DO_UPCAST(AFXDPState, nc, nc);
+    size_t size = iov_size(iov, iovcnt);
     struct xdp_desc *desc;
     uint32_t idx;
     void *data;
@@ -171,8 +172,9 @@ static ssize_t af_xdp_receive(NetClientState *nc,
     desc->addr = s->pool[--s->n_pool];
     desc->len = size;
 
+    /* Gather straight into the frame, no need to linearize first. */
     data = xsk_umem__get_data(s->buffer, desc->addr);
-    memcpy(data, buf, size);
+    iov_to_buf(iov, iovcnt, 0, data, size);
 
     xsk_ring_prod__submit(&s->tx, 1);
     s->outstanding_tx++;
@@ -184,6 +186,17 @@ static ssize_t af_xdp_receive(NetClientState *nc,
     return size;
 }
 
+static ssize_t af_xdp_receive(NetClientState *nc,
+                              const uint8_t *buf, size_t size)
+{
+    struct iovec iov = {
+        .iov_base = (void *)buf,
+        .iov_len = size
+    };
+
+    return af_xdp_receive_iov(nc, &iov, 1);
+}
+
 /*
  * Complete a previous send (backend --> guest) and enable the
  * fd_read callback.
@@ -221,6 +234,8 @@ static void af_xdp_fq_refill(AFXDPState *s, uint32_t n)
 
 static void af_xdp_send(void *opaque)
 {
+    struct iovec iov[AF_XDP_BATCH_SIZE];
+    NetPacketVec pkts[AF_XDP_BATCH_SIZE];
     uint32_t i, n_rx, idx = 0;
     AFXDPState *s = opaque;
 
@@ -231,31 +246,32 @@ static void af_xdp_send(void *opaque)
 
     for (i = 0; i < n_rx; i++) {
         const struct xdp_desc *desc;
-        struct iovec iov;
 
         desc = xsk_ring_cons__rx_desc(&s->rx, idx++);
 
-        iov.iov_base = xsk_umem__get_data(s->buffer, desc->addr);
-        iov.iov_len = desc->len;
+        iov[i].iov_base = xsk_umem__get_data(s->buffer, desc->addr);
+        iov[i].iov_len = desc->len;
+        pkts[i].iov = &iov[i];
+        pkts[i].iovcnt = 1;
 
         s->pool[s->n_pool++] = desc->addr;
+    }
 
-        if (!qemu_sendv_packet_async(&s->nc, &iov, 1,
-                                     af_xdp_send_completed)) {
-            /*
-             * The peer does not receive anymore.  Packet is queued, stop
-             * reading from the backend until af_xdp_send_completed().
-             */
-            af_xdp_read_poll(s, false);
-
-            /* Return unused descriptors to not break the ring cache. */
-            xsk_ring_cons__cancel(&s->rx, n_rx - i - 1);
-            n_rx = i + 1;
-            break;
-        }
+    /*
+     * Hand the whole burst to the peer at once, so that e.g. virtio-net
+     * only updates the used ring and notifies the guest once.
+     */
+    if (qemu_sendv_packet_batch_async(&s->nc, pkts, n_rx,
+                                      af_xdp_send_completed) < n_rx) {
+        /*
+         * The peer does not receive anymore.  The remaining packets are
+         * queued, stop reading from the backend until
+         * af_xdp_send_completed().
+         */
+        af_xdp_read_poll(s, false);
     }
 
-    /* Release actually sent descriptors and try to re-fill. */
+    /* Release the descriptors and try to re-fill. */
     xsk_ring_cons__release(&s->rx, n_rx);
     af_xdp_fq_refill(s, AF_XDP_BATCH_SIZE);
 }
@@ -437,6 +453,7 @@ static NetClientInfo net_af_xdp_info = {
     .type = NET_CLIENT_DRIVER_AF_XDP,
     .size = sizeof(AFXDPState),
     .receive = af_xdp_receive,
+    .receive_iov = af_xdp_receive_iov,
     .poll = af_xdp_poll,
     .cleanup = af_xdp_cleanup,
 };
@@ -16,27 +16,101 @@
  */
 
 #include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/host-utils.h"
+#include "host/cpuinfo.h"
+#include "crypto/clmul.h"
 #include "net/checksum.h"
 #include "net/eth.h"
 
+typedef uint64_t (*csum_accel_fn)(const uint8_t *, size_t);
+
+/*
+ * Sum the host-endian 32-bit words of @buf; @len is a multiple of 8.
+ * Since 2^16 == 1 in one's complement arithmetic, the result folds to
+ * the same checksum as a sum of 16-bit words, only byte swapped on
+ * little-endian hosts.
+ */
+static uint64_t net_checksum_add_int(const uint8_t *buf, size_t len)
+{
+    uint64_t sum0 = 0, sum1 = 0;
+    size_t i;
+
+    for (i = 0; i < len; i += 8) {
+        uint64_t x = ldq_he_p(buf + i);
+
+        sum0 += (uint32_t)x;
+        sum1 += x >> 32;
+    }
+
+    return sum0 + sum1;
+}
+
+#include "host/checksum.c.inc"
+
+static csum_accel_fn net_checksum_accel;
+static unsigned csum_accel_index;
+
+static void __attribute__((constructor)) init_accel(void)
+{
+    csum_accel_index = csum_best_accel();
+    net_checksum_accel = csum_accel_table[csum_accel_index];
+}
+
+/*
+ * The implementations usable on this host are csum_accel_table[0] up to
+ * csum_accel_table[csum_best_accel()].
+ */
+bool test_net_checksum_next_accel(void)
+{
+    if (csum_accel_index != 0) {
+        net_checksum_accel = csum_accel_table[--csum_accel_index];
+        return true;
+    }
+    return false;
+}
+
+/* Vectorizing does not pay off for headers */
+#define NET_CHECKSUM_ACCEL_MIN 128
+
 uint32_t net_checksum_add_cont(int len, uint8_t *buf, int seq)
 {
-    uint32_t sum1 = 0, sum2 = 0;
-    int i;
+    uint8_t tail[8] = { 0 };
+    size_t body;
+    uint64_t sum, x;
+    uint32_t res;
 
-    for (i = 0; i < len - 1; i += 2) {
-        sum1 += (uint32_t)buf[i];
-        sum2 += (uint32_t)buf[i + 1];
+    if (len <= 0) {
+        return 0;
     }
-    if (i < len) {
-        sum1 += (uint32_t)buf[i];
+
+    body = len & ~7;
+    if (body >= NET_CHECKSUM_ACCEL_MIN) {
+        sum = net_checksum_accel(buf, body);
+    } else {
+        sum = net_checksum_add_int(buf, body);
     }
 
+    /* Zero padding keeps an odd last byte in the high half of its word */
+    memcpy(tail, buf + body, len - body);
+    x = ldq_he_p(tail);
+    sum += (uint32_t)x + (x >> 32);
+
+    /* End-around carries never turn a non-zero sum into zero */
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    res = (sum & 0xffff) + (sum >> 16);
+    res = (res & 0xffff) + (res >> 16);
+
+    if (!HOST_BIG_ENDIAN) {
+        res = bswap16(res);
+    }
+    /* Data starting at an odd offset has its bytes swapped */
     if (seq & 1) {
-        return sum1 + (sum2 << 8);
-    } else {
-        return sum2 + (sum1 << 8);
+        res = bswap16(res);
     }
+
+    return res;
 }
 
 uint16_t net_checksum_finish(uint32_t sum)
@@ -206,3 +280,37 @@ net_checksum_add_iov(const struct iovec *iov, const unsigned int iov_cnt,
     }
     return res;
 }
+
+/*
+ * Hash 32 bits of input with the 64 key bits starting at the same bit
+ * position.  Every input bit j (counting from the most significant one)
+ * that is set adds key bits j..j+31, i.e. bits 32..63 of key << j.  The
+ * sum over all those shifts is a carry-less multiplication by the
+ * bit-reversed input.
+ */
+static inline uint32_t net_toeplitz_hash32(uint64_t key, uint32_t input)
+{
+    return int128_getlo(clmul_64(key, revbit32(input))) >> 32;
+}
+
+uint32_t net_toeplitz_hash(const uint8_t *key, const uint8_t *input,
+                           size_t len)
+{
+    uint32_t result = 0;
+    size_t i;
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        result ^= net_toeplitz_hash32(ldq_be_p(key + i), ldl_be_p(input + i));
+    }
+
+    if (i < len) {
+        uint8_t tail_key[8] = { 0 };
+        uint8_t tail[4] = { 0 };
+
+        memcpy(tail_key, key + i, len - i + 4);
+        memcpy(tail, input + i, len - i);
+        result ^= net_toeplitz_hash32(ldq_be_p(tail_key), ldl_be_p(tail));
+    }
+
+    return result;
+}
@@ -126,7 +126,8 @@ static void filter_buffer_setup(NetFilterState *nf, Error **errp)
         return;
     }
 
-    s->incoming_queue = qemu_new_net_queue(qemu_netfilter_pass_to_next, nf);
+    s->incoming_queue = qemu_new_net_queue(qemu_netfilter_pass_to_next,
+                                           NULL, nf);
     filter_buffer_setup_timer(nf);
 }
 
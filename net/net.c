@@ -259,6 +259,11 @@ static ssize_t qemu_deliver_packet_iov(NetClientState *sender,
                                        const struct iovec *iov,
                                        int iovcnt,
                                        void *opaque);
+static int qemu_deliver_packet_batch(NetClientState *sender,
+                                     unsigned flags,
+                                     const NetPacketVec *pkts,
+                                     int npkts,
+                                     void *opaque);
 
 static void qemu_net_client_setup(NetClientState *nc,
                                   NetClientInfo *info,
@@ -283,7 +288,8 @@ static void qemu_net_client_setup(NetClientState *nc,
     }
     QTAILQ_INSERT_TAIL(&net_clients, nc, next);
 
-    nc->incoming_queue = qemu_new_net_queue(qemu_deliver_packet_iov, nc);
+    nc->incoming_queue = qemu_new_net_queue(qemu_deliver_packet_iov,
+                                             qemu_deliver_packet_batch, nc);
     nc->destructor = destructor;
     nc->is_datapath = is_datapath;
     QTAILQ_INIT(&nc->filters);
@@ -861,6 +867,57 @@ static ssize_t qemu_deliver_packet_iov(NetClientState *sender,
     return ret;
 }
 
+static int qemu_deliver_packet_batch(NetClientState *sender,
+                                     unsigned flags,
+                                     const NetPacketVec *pkts,
+                                     int npkts,
+                                     void *opaque)
+{
+    MemReentrancyGuard *owned_reentrancy_guard;
+    NetClientState *nc = opaque;
+    int i;
+
+    if (nc->link_down) {
+        return npkts;
+    }
+
+    if (nc->receive_disabled) {
+        return 0;
+    }
+
+    /* Raw packets need a vnet header prepended, do those one at a time */
+    if (!nc->info->receive_batch ||
+        ((flags & QEMU_NET_PACKET_FLAG_RAW) && nc->vnet_hdr_len)) {
+        for (i = 0; i < npkts; i++) {
+            if (qemu_deliver_packet_iov(sender, flags, pkts[i].iov,
+                                        pkts[i].iovcnt, opaque) == 0) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    if (nc->info->type != NET_CLIENT_DRIVER_NIC ||
+        qemu_get_nic(nc)->reentrancy_guard->engaged_in_io) {
+        owned_reentrancy_guard = NULL;
+    } else {
+        owned_reentrancy_guard = qemu_get_nic(nc)->reentrancy_guard;
+        owned_reentrancy_guard->engaged_in_io = true;
+    }
+
+    i = nc->info->receive_batch(nc, pkts, npkts);
+
+    if (owned_reentrancy_guard) {
+        owned_reentrancy_guard->engaged_in_io = false;
+    }
+
+    if (i < npkts) {
+        nc->receive_disabled = 1;
+    }
+
+    return i;
+}
+
 ssize_t qemu_sendv_packet_async(NetClientState *sender,
                                 const struct iovec *iov, int iovcnt,
                                 NetPacketSent *sent_cb)
@@ -897,6 +954,52 @@ ssize_t qemu_sendv_packet_async(NetClientState *sender,
                                    iov, iovcnt, sent_cb);
 }
 
+/*
+ * Send @npkts packets from @sender in one go.  Returns the number of
+ * packets that went through immediately; if that is less than @npkts
+ * the rest were queued and @sent_cb will be called once each of them
+ * has been delivered, as with a zero return from
+ * qemu_sendv_packet_async().
+ */
+int qemu_sendv_packet_batch_async(NetClientState *sender,
+                                  const NetPacketVec *pkts, int npkts,
+                                  NetPacketSent *sent_cb)
+{
+    NetQueue *queue;
+    int i, n;
+
+    if (sender->link_down || !sender->peer) {
+        return npkts;
+    }
+
+    for (i = 0; i < npkts; i++) {
+        if (iov_size(pkts[i].iov, pkts[i].iovcnt) > NET_BUFSIZE) {
+            break;
+        }
+    }
+
+    /*
+     * Filters work on single packets and may queue or drop any of them,
+     * so give each packet its own trip through the filter chain.
+     */
+    if (i < npkts || !QTAILQ_EMPTY(&sender->filters) ||
+        !QTAILQ_EMPTY(&sender->peer->filters)) {
+        n = npkts;
+        for (i = 0; i < npkts; i++) {
+            if (qemu_sendv_packet_async(sender, pkts[i].iov, pkts[i].iovcnt,
+                                        sent_cb) == 0 && n == npkts) {
+                n = i;
+            }
+        }
+        return n;
+    }
+
+    queue = sender->peer->incoming_queue;
+
+    return qemu_net_queue_send_batch(queue, sender, QEMU_NET_PACKET_FLAG_NONE,
+                                     pkts, npkts, sent_cb);
+}
+
 ssize_t
 qemu_sendv_packet(NetClientState *nc, const struct iovec *iov, int iovcnt)
 {
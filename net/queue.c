@@ -54,13 +54,16 @@ struct NetQueue {
     uint32_t nq_maxlen;
     uint32_t nq_count;
     NetQueueDeliverFunc *deliver;
+    NetQueueDeliverBatchFunc *deliver_batch;
 
     QTAILQ_HEAD(, NetPacket) packets;
 
     unsigned delivering : 1;
 };
 
-NetQueue *qemu_new_net_queue(NetQueueDeliverFunc *deliver, void *opaque)
+NetQueue *qemu_new_net_queue(NetQueueDeliverFunc *deliver,
+                             NetQueueDeliverBatchFunc *deliver_batch,
+                             void *opaque)
 {
     NetQueue *queue;
 
@@ -70,6 +73,7 @@ NetQueue *qemu_new_net_queue(NetQueueDeliverFunc *deliver, void *opaque)
     queue->nq_maxlen = 10000;
     queue->nq_count = 0;
     queue->deliver = deliver;
+    queue->deliver_batch = deliver_batch;
 
     QTAILQ_INIT(&queue->packets);
 
@@ -182,6 +186,31 @@ static ssize_t qemu_net_queue_deliver_iov(NetQueue *queue,
     return ret;
 }
 
+static int qemu_net_queue_deliver_batch(NetQueue *queue,
+                                        NetClientState *sender,
+                                        unsigned flags,
+                                        const NetPacketVec *pkts,
+                                        int npkts)
+{
+    int i;
+
+    if (!queue->deliver_batch) {
+        for (i = 0; i < npkts; i++) {
+            if (qemu_net_queue_deliver_iov(queue, sender, flags,
+                                           pkts[i].iov, pkts[i].iovcnt) == 0) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    queue->delivering = 1;
+    i = queue->deliver_batch(sender, flags, pkts, npkts, queue->opaque);
+    queue->delivering = 0;
+
+    return i;
+}
+
 ssize_t qemu_net_queue_receive(NetQueue *queue,
                                const uint8_t *data,
                                size_t size)
@@ -243,6 +272,35 @@ ssize_t qemu_net_queue_send_iov(NetQueue *queue,
     return ret;
 }
 
+/* Returns the number of packets that were delivered straight away.  If
+ * that is less than @npkts, the rest have been queued and the caller
+ * must not send any more packets until @sent_cb has been invoked.
+ */
+int qemu_net_queue_send_batch(NetQueue *queue,
+                              NetClientState *sender,
+                              unsigned flags,
+                              const NetPacketVec *pkts,
+                              int npkts,
+                              NetPacketSent *sent_cb)
+{
+    int i, n = 0;
+
+    if (!queue->delivering && qemu_can_send_packet(sender)) {
+        n = qemu_net_queue_deliver_batch(queue, sender, flags, pkts, npkts);
+    }
+
+    for (i = n; i < npkts; i++) {
+        qemu_net_queue_append_iov(queue, sender, flags,
+                                  pkts[i].iov, pkts[i].iovcnt, sent_cb);
+    }
+
+    if (n == npkts) {
+        qemu_net_queue_flush(queue);
+    }
+
+    return n;
+}
+
 void qemu_net_queue_purge(NetQueue *queue, NetClientState *from)
 {
     NetPacket *packet, *next;
@@ -0,0 +1,380 @@
+/*
+ * io_uring based I/O for tap devices
+ *
+ * Received packets are read with a single multishot read into a ring of
+ * provided buffers, so the kernel keeps filling buffers without a
+ * syscall per packet.  Transmitted packets are copied into a private
+ * buffer and queued as write requests that are submitted together from
+ * a bottom half.  Completions are processed in the main loop's
+ * iohandler AioContext, like every other tap event.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include <liburing.h>
+#include "tap_int.h"
+#include "block/aio.h"
+#include "net/net.h"
+#include "qapi/error.h"
+#include "qemu/error-report.h"
+#include "qemu/iov.h"
+#include "qemu/main-loop.h"
+#include "qemu/timer.h"
+
+/* Number of RX buffers; must be a power of two */
+#define TAP_URING_RX_BUFS 64
+
+/* Maximum number of TX requests in flight */
+#define TAP_URING_TX_DEPTH 64
+
+#define TAP_URING_ENTRIES (TAP_URING_RX_BUFS + TAP_URING_TX_DEPTH)
+
+/* Delay before rearming the read after it failed */
+#define TAP_URING_READ_RETRY_MS 10
+
+/* Buffer group used for the RX provided buffer ring */
+#define TAP_URING_BGID 0
+
+/* user_data of the multishot read, TX requests carry their TapUringTx */
+#define TAP_URING_READ ((void *)1)
+#define TAP_URING_CANCEL ((void *)2)
+
+typedef struct TapUringTx {
+    size_t len;
+    uint8_t data[];
+} TapUringTx;
+
+struct TapUring {
+    struct io_uring ring;
+    int fd;
+    QEMUBH *bh;
+    QEMUTimer *retry_timer;
+
+    TapUringReadFunc *read_cb;
+    TapUringWritableFunc *writable_cb;
+    void *opaque;
+
+    /* RX */
+    struct io_uring_buf_ring *buf_ring;
+    uint8_t *rx_bufs;
+    bool read_enabled;
+    bool read_armed;
+    bool read_retry;
+    /* Completed reads not yet handed to read_cb, oldest first */
+    uint16_t rx_bid[TAP_URING_RX_BUFS];
+    uint32_t rx_len[TAP_URING_RX_BUFS];
+    unsigned rx_head;
+    unsigned rx_count;
+
+    /* TX */
+    unsigned tx_inflight;
+    bool tx_blocked;
+};
+
+static uint8_t *tap_uring_rx_buf(TapUring *tu, unsigned bid)
+{
+    return tu->rx_bufs + (size_t)bid * NET_BUFSIZE;
+}
+
+static struct io_uring_sqe *tap_uring_get_sqe(TapUring *tu)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&tu->ring);
+
+    if (!sqe) {
+        /* Make room by submitting what has been queued so far */
+        io_uring_submit(&tu->ring);
+        sqe = io_uring_get_sqe(&tu->ring);
+    }
+    return sqe;
+}
+
+static void tap_uring_arm_read(TapUring *tu)
+{
+    struct io_uring_sqe *sqe;
+
+    if (tu->read_armed || tu->read_retry || !tu->read_enabled) {
+        return;
+    }
+
+    sqe = tap_uring_get_sqe(tu);
+    if (!sqe) {
+        return;
+    }
+
+    io_uring_prep_read_multishot(sqe, tu->fd, 0, 0, TAP_URING_BGID);
+    io_uring_sqe_set_data(sqe, TAP_URING_READ);
+    tu->read_armed = true;
+}
+
+static void tap_uring_recycle(TapUring *tu, unsigned bid, int offset)
+{
+    io_uring_buf_ring_add(tu->buf_ring, tap_uring_rx_buf(tu, bid),
+                          NET_BUFSIZE, bid,
+                          io_uring_buf_ring_mask(TAP_URING_RX_BUFS), offset);
+}
+
+static void tap_uring_deliver(TapUring *tu)
+{
+    while (tu->rx_count && tu->read_enabled) {
+        struct iovec iov[TAP_URING_RX_BUFS];
+        unsigned bids[TAP_URING_RX_BUFS];
+        int i, n = 0;
+
+        while (tu->rx_count) {
+            unsigned slot = tu->rx_head;
+
+            bids[n] = tu->rx_bid[slot];
+            iov[n].iov_base = tap_uring_rx_buf(tu, bids[n]);
+            iov[n].iov_len = tu->rx_len[slot];
+            n++;
+
+            tu->rx_head = (slot + 1) % TAP_URING_RX_BUFS;
+            tu->rx_count--;
+        }
+
+        /* May disable reads again, which stops the outer loop */
+        tu->read_cb(tu->opaque, iov, n);
+
+        for (i = 0; i < n; i++) {
+            tap_uring_recycle(tu, bids[i], i);
+        }
+        io_uring_buf_ring_advance(tu->buf_ring, n);
+    }
+}
+
+static void tap_uring_process_completions(TapUring *tu)
+{
+    struct io_uring_cqe *cqe;
+    bool writable = false;
+
+    while (io_uring_peek_cqe(&tu->ring, &cqe) == 0) {
+        void *data = io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+
+        io_uring_cqe_seen(&tu->ring, cqe);
+
+        if (data == TAP_URING_READ) {
+            if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+                unsigned slot = (tu->rx_head + tu->rx_count) %
+                                TAP_URING_RX_BUFS;
+
+                tu->rx_bid[slot] = flags >> IORING_CQE_BUFFER_SHIFT;
+                tu->rx_len[slot] = res;
+                tu->rx_count++;
+            } else if (flags & IORING_CQE_F_BUFFER) {
+                /* Empty read, give the buffer straight back */
+                tap_uring_recycle(tu, flags >> IORING_CQE_BUFFER_SHIFT, 0);
+                io_uring_buf_ring_advance(tu->buf_ring, 1);
+            }
+
+            /*
+             * The multishot read stops when it runs out of buffers, and
+             * is rearmed below once they have been recycled.  On other
+             * errors rearm it after a delay rather than spinning on a
+             * broken file descriptor.
+             */
+            if (!(flags & IORING_CQE_F_MORE)) {
+                tu->read_armed = false;
+                if (res < 0 && res != -ENOBUFS) {
+                    error_report_once("tap: io_uring read failed: %s",
+                                      strerror(-res));
+                    tu->read_retry = true;
+                    timer_mod(tu->retry_timer,
+                              qemu_clock_get_ms(QEMU_CLOCK_REALTIME) +
+                              TAP_URING_READ_RETRY_MS);
+                }
+            }
+        } else if (data == TAP_URING_CANCEL) {
+            continue;
+        } else {
+            /* Write errors drop the packet, like a failed writev() */
+            g_free(data);
+            tu->tx_inflight--;
+            if (tu->tx_blocked) {
+                tu->tx_blocked = false;
+                writable = true;
+            }
+        }
+    }
+
+    tap_uring_deliver(tu);
+    tap_uring_arm_read(tu);
+
+    if (io_uring_sq_ready(&tu->ring)) {
+        io_uring_submit(&tu->ring);
+    }
+
+    if (writable) {
+        tu->writable_cb(tu->opaque);
+    }
+}
+
+static void tap_uring_completion_cb(void *opaque)
+{
+    tap_uring_process_completions(opaque);
+}
+
+static void tap_uring_bh(void *opaque)
+{
+    tap_uring_process_completions(opaque);
+}
+
+static void tap_uring_retry_read(void *opaque)
+{
+    TapUring *tu = opaque;
+
+    tu->read_retry = false;
+    tap_uring_process_completions(tu);
+}
+
+void tap_uring_set_read_poll(TapUring *tu, bool enable)
+{
+    if (tu->read_enabled == enable) {
+        return;
+    }
+
+    tu->read_enabled = enable;
+    if (enable) {
+        /* Deliver what was held back and rearm outside of the caller */
+        qemu_bh_schedule(tu->bh);
+    }
+}
+
+ssize_t tap_uring_write(TapUring *tu, const struct iovec *iov, int iovcnt)
+{
+    struct io_uring_sqe *sqe;
+    TapUringTx *tx;
+    size_t len;
+
+    if (tu->tx_inflight >= TAP_URING_TX_DEPTH) {
+        tu->tx_blocked = true;
+        return 0;
+    }
+
+    sqe = tap_uring_get_sqe(tu);
+    if (!sqe) {
+        tu->tx_blocked = true;
+        return 0;
+    }
+
+    /* The caller's buffers are only valid until we return */
+    len = iov_size(iov, iovcnt);
+    tx = g_malloc(sizeof(*tx) + len);
+    tx->len = iov_to_buf(iov, iovcnt, 0, tx->data, len);
+
+    io_uring_prep_write(sqe, tu->fd, tx->data, tx->len, 0);
+    io_uring_sqe_set_data(sqe, tx);
+    tu->tx_inflight++;
+
+    /* Submit all writes queued in this main loop iteration at once */
+    qemu_bh_schedule(tu->bh);
+
+    return len;
+}
+
+TapUring *tap_uring_new(int fd, TapUringReadFunc *read_cb,
+                        TapUringWritableFunc *writable_cb, void *opaque,
+                        Error **errp)
+{
+    TapUring *tu = g_new0(TapUring, 1);
+    struct io_uring_probe *probe;
+    bool supported;
+    int ret, i;
+
+    ret = io_uring_queue_init(TAP_URING_ENTRIES, &tu->ring, 0);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "failed to init linux io_uring ring");
+        g_free(tu);
+        return NULL;
+    }
+
+    probe = io_uring_get_probe_ring(&tu->ring);
+    supported = probe &&
+                io_uring_opcode_supported(probe, IORING_OP_READ_MULTISHOT);
+    io_uring_free_probe(probe);
+    if (!supported) {
+        error_setg(errp, "io_uring multishot read is not supported by the "
+                   "host kernel");
+        goto fail;
+    }
+
+    tu->buf_ring = io_uring_setup_buf_ring(&tu->ring, TAP_URING_RX_BUFS,
+                                           TAP_URING_BGID, 0, &ret);
+    if (!tu->buf_ring) {
+        error_setg_errno(errp, -ret, "failed to set up io_uring buffer ring");
+        goto fail;
+    }
+
+    tu->rx_bufs = qemu_memalign(qemu_real_host_page_size(),
+                                (size_t)TAP_URING_RX_BUFS * NET_BUFSIZE);
+    for (i = 0; i < TAP_URING_RX_BUFS; i++) {
+        tap_uring_recycle(tu, i, i);
+    }
+    io_uring_buf_ring_advance(tu->buf_ring, TAP_URING_RX_BUFS);
+
+    tu->fd = fd;
+    tu->read_cb = read_cb;
+    tu->writable_cb = writable_cb;
+    tu->opaque = opaque;
+    tu->bh = aio_bh_new(iohandler_get_aio_context(), tap_uring_bh, tu);
+    tu->retry_timer = aio_timer_new(iohandler_get_aio_context(),
+                                    QEMU_CLOCK_REALTIME, SCALE_MS,
+                                    tap_uring_retry_read, tu);
+    qemu_set_fd_handler(tu->ring.ring_fd, tap_uring_completion_cb, NULL, tu);
+
+    return tu;
+
+fail:
+    io_uring_queue_exit(&tu->ring);
+    g_free(tu);
+    return NULL;
+}
+
+void tap_uring_cleanup(TapUring *tu)
+{
+    struct io_uring_cqe *cqe;
+    struct io_uring_sqe *sqe;
+    bool cancelling = false;
+
+    qemu_set_fd_handler(tu->ring.ring_fd, NULL, NULL, NULL);
+    qemu_bh_delete(tu->bh);
+    timer_free(tu->retry_timer);
+
+    /*
+     * Cancel the read and any writes not yet started, and wait for all
+     * of them before the buffers they point to are freed.
+     */
+    sqe = tap_uring_get_sqe(tu);
+    if (sqe) {
+        io_uring_prep_cancel(sqe, NULL, IORING_ASYNC_CANCEL_ANY);
+        io_uring_sqe_set_data(sqe, TAP_URING_CANCEL);
+        cancelling = true;
+    }
+    io_uring_submit(&tu->ring);
+
+    while ((tu->read_armed || tu->tx_inflight || cancelling) &&
+           io_uring_wait_cqe(&tu->ring, &cqe) == 0) {
+        void *data = io_uring_cqe_get_data(cqe);
+
+        if (data == TAP_URING_READ) {
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                tu->read_armed = false;
+            }
+        } else if (data == TAP_URING_CANCEL) {
+            cancelling = false;
+        } else {
+            g_free(data);
+            tu->tx_inflight--;
+        }
+        io_uring_cqe_seen(&tu->ring, cqe);
+    }
+
+    io_uring_free_buf_ring(&tu->ring, tu->buf_ring, TAP_URING_RX_BUFS,
+                           TAP_URING_BGID);
+    io_uring_queue_exit(&tu->ring);
+    qemu_vfree(tu->rx_bufs);
+    g_free(tu);
+}
@@ -65,12 +65,19 @@ static const int kernel_feature_bits[] = {
     VHOST_INVALID_FEATURE_BIT
 };
 
+/*
+ * Packets read from the tap device are passed to the peer in batches of
+ * up to TAP_BATCH_SIZE.  Each read needs NET_BUFSIZE bytes of room, so a
+ * batch ends early if the buffer fills up with large packets.
+ */
+#define TAP_BATCH_SIZE 32
+
 typedef struct TAPState {
     NetClientState nc;
     int fd;
     char down_script[1024];
     char down_script_arg[128];
-    uint8_t buf[NET_BUFSIZE];
+    uint8_t buf[NET_BUFSIZE * 2];
     bool read_poll;
     bool write_poll;
     bool using_vnet_hdr;
@@ -80,6 +87,9 @@ typedef struct TAPState {
     VHostNetState *vhost_net;
     unsigned host_vnet_hdr_len;
     Notifier exit;
+#ifdef CONFIG_TAP_IO_URING
+    TapUring *uring;
+#endif
 } TAPState;
 
 static void launch_script(const char *setup_script, const char *ifname,
@@ -90,6 +100,12 @@ static void tap_writable(void *opaque);
 
 static void tap_update_fd_handler(TAPState *s)
 {
+#ifdef CONFIG_TAP_IO_URING
+    if (s->uring) {
+        tap_uring_set_read_poll(s->uring, s->read_poll && s->enabled);
+        return;
+    }
+#endif
     qemu_set_fd_handler(s->fd,
                         s->read_poll && s->enabled ? tap_send : NULL,
                         s->write_poll && s->enabled ? tap_writable : NULL,
@@ -121,6 +137,12 @@ static ssize_t tap_write_packet(TAPState *s, const struct iovec *iov, int iovcnt
 {
     ssize_t len;
 
+#ifdef CONFIG_TAP_IO_URING
+    if (s->uring) {
+        return tap_uring_write(s->uring, iov, iovcnt);
+    }
+#endif
+
     len = RETRY_ON_EINTR(writev(s->fd, iov, iovcnt));
 
     if (len == -1 && errno == EAGAIN) {
@@ -174,59 +196,124 @@ static void tap_send_completed(NetClientState *nc, ssize_t len)
     tap_read_poll(s, true);
 }
 
+/*
+ * Turn a packet read into @buf into what is passed to the peer.  @buf
+ * must have room for padding the packet to the minimum frame length.
+ */
+static bool tap_prepare_packet(TAPState *s, uint8_t *buf, int size,
+                               struct iovec *iov)
+{
+    if (s->host_vnet_hdr_len && size <= s->host_vnet_hdr_len) {
+        /* Invalid packet */
+        return false;
+    }
+
+    if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
+        buf  += s->host_vnet_hdr_len;
+        size -= s->host_vnet_hdr_len;
+    }
+
+    if (net_peer_needs_padding(&s->nc) && size < ETH_ZLEN) {
+        memset(buf + size, 0, ETH_ZLEN - size);
+        size = ETH_ZLEN;
+    }
+
+    iov->iov_base = buf;
+    iov->iov_len = size;
+    return true;
+}
+
 static void tap_send(void *opaque)
 {
     TAPState *s = opaque;
-    int size;
     int packets = 0;
 
-    while (true) {
-        uint8_t *buf = s->buf;
-        uint8_t min_pkt[ETH_ZLEN];
-        size_t min_pktsz = sizeof(min_pkt);
+    /*
+     * When the host keeps receiving more packets while tap_send() is
+     * running we can hog the BQL.  Limit the number of
+     * packets that are processed per tap_send() callback to prevent
+     * stalling the guest.
+     */
+    while (packets < 50) {
+        struct iovec iov[TAP_BATCH_SIZE];
+        NetPacketVec pkts[TAP_BATCH_SIZE];
+        int max = MIN(TAP_BATCH_SIZE, 50 - packets);
+        size_t offset = 0;
+        bool more = true;
+        int npkts = 0;
+        int sent;
+
+        while (npkts < max && sizeof(s->buf) - offset >= NET_BUFSIZE) {
+            uint8_t *buf = s->buf + offset;
+            int size;
+
+            size = tap_read_packet(s->fd, buf, NET_BUFSIZE);
+            if (size <= 0 || !tap_prepare_packet(s, buf, size, &iov[npkts])) {
+                more = false;
+                break;
+            }
+
+            pkts[npkts].iov = &iov[npkts];
+            pkts[npkts].iovcnt = 1;
+            offset = (uint8_t *)iov[npkts].iov_base + iov[npkts].iov_len -
+                     s->buf;
+            npkts++;
+        }
 
-        size = tap_read_packet(s->fd, s->buf, sizeof(s->buf));
-        if (size <= 0) {
+        if (npkts == 0) {
             break;
         }
 
-        if (s->host_vnet_hdr_len && size <= s->host_vnet_hdr_len) {
-            /* Invalid packet */
+        sent = qemu_sendv_packet_batch_async(&s->nc, pkts, npkts,
+                                             tap_send_completed);
+        if (sent < npkts) {
+            tap_read_poll(s, false);
             break;
         }
 
-        if (s->host_vnet_hdr_len && !s->using_vnet_hdr) {
-            buf  += s->host_vnet_hdr_len;
-            size -= s->host_vnet_hdr_len;
+        packets += npkts;
+        if (!more) {
+            break;
         }
+    }
+}
+
+#ifdef CONFIG_TAP_IO_URING
+static void tap_uring_read(void *opaque, struct iovec *bufs, int nbufs)
+{
+    TAPState *s = opaque;
+    bool blocked = false;
+    int i = 0;
 
-        if (net_peer_needs_padding(&s->nc)) {
-            if (eth_pad_short_frame(min_pkt, &min_pktsz, buf, size)) {
-                buf = min_pkt;
-                size = min_pktsz;
+    /*
+     * The buffers are recycled when we return, so anything the peer
+     * cannot take right now has to be queued rather than left behind.
+     */
+    while (i < nbufs) {
+        struct iovec iov[TAP_BATCH_SIZE];
+        NetPacketVec pkts[TAP_BATCH_SIZE];
+        int npkts = 0;
+
+        for (; i < nbufs && npkts < TAP_BATCH_SIZE; i++) {
+            if (tap_prepare_packet(s, bufs[i].iov_base, bufs[i].iov_len,
+                                   &iov[npkts])) {
+                pkts[npkts].iov = &iov[npkts];
+                pkts[npkts].iovcnt = 1;
+                npkts++;
             }
         }
 
-        size = qemu_send_packet_async(&s->nc, buf, size, tap_send_completed);
-        if (size == 0) {
-            tap_read_poll(s, false);
-            break;
-        } else if (size < 0) {
-            break;
+        if (qemu_sendv_packet_batch_async(&s->nc, pkts, npkts,
+                                          tap_send_completed) < npkts) {
+            blocked = true;
         }
+    }
 
-        /*
-         * When the host keeps receiving more packets while tap_send() is
-         * running we can hog the BQL.  Limit the number of
-         * packets that are processed per tap_send() callback to prevent
-         * stalling the guest.
-         */
-        packets++;
-        if (packets >= 50) {
-            break;
-        }
+    if (blocked) {
+        tap_read_poll(s, false);
     }
 }
+#endif
 
 static bool tap_has_ufo(NetClientState *nc)
 {
@@ -326,6 +413,12 @@ static void tap_cleanup(NetClientState *nc)
 
     tap_read_poll(s, false);
     tap_write_poll(s, false);
+#ifdef CONFIG_TAP_IO_URING
+    if (s->uring) {
+        tap_uring_cleanup(s->uring);
+        s->uring = NULL;
+    }
+#endif
     close(s->fd);
     s->fd = -1;
 }
@@ -765,6 +858,23 @@ static void net_init_tap_one(const NetdevTapOptions *tap, NetClientState *peer,
         goto failed;
     }
 
+#ifdef CONFIG_TAP_IO_URING
+    if (tap->has_io_uring && tap->io_uring) {
+        if (s->vhost_net) {
+            error_setg(errp, "io-uring=on is not valid with vhost");
+            goto failed;
+        }
+
+        s->uring = tap_uring_new(s->fd, tap_uring_read, tap_writable, s, errp);
+        if (!s->uring) {
+            goto failed;
+        }
+        /* From now on the tap fd is only read and written through the ring */
+        qemu_set_fd_handler(s->fd, NULL, NULL, NULL);
+        tap_update_fd_handler(s);
+    }
+#endif
+
     return;
 
 failed:
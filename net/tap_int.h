@@ -47,4 +47,23 @@ int tap_fd_disable(int fd);
 int tap_fd_get_ifname(int fd, char *ifname);
 int tap_fd_set_steering_ebpf(int fd, int prog_fd);
 
+#ifdef CONFIG_TAP_IO_URING
+typedef struct TapUring TapUring;
+
+/*
+ * Called with packets read from the tap device.  Each buffer has room
+ * for NET_BUFSIZE bytes and is reused as soon as the callback returns.
+ */
+typedef void (TapUringReadFunc)(void *opaque, struct iovec *pkts, int npkts);
+/* Called when a write that returned 0 may be retried */
+typedef void (TapUringWritableFunc)(void *opaque);
+
+TapUring *tap_uring_new(int fd, TapUringReadFunc *read_cb,
+                        TapUringWritableFunc *writable_cb, void *opaque,
+                        Error **errp);
+void tap_uring_cleanup(TapUring *tu);
+void tap_uring_set_read_poll(TapUring *tu, bool enable);
+ssize_t tap_uring_write(TapUring *tu, const struct iovec *iov, int iovcnt);
+#endif
+
 #endif /* NET_TAP_INT_H */
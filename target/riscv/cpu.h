@@ -703,6 +703,10 @@ FIELD(TB_FLAGS, BCFI_ENABLED, 28, 1)
 FIELD(TB_FLAGS, PM_PMM, 29, 2)
 FIELD(TB_FLAGS, PM_SIGNEXTEND, 31, 1)
 
+/* TB_FLAGS is full, further state is carried in cs_base */
+/* Dynamic rounding mode, so that it is known at translation time */
+FIELD(TB_FLAGS2, FRM, 0, 3)
+
 #ifdef TARGET_RISCV32
 #define riscv_cpu_mxl(env)  ((void)(env), MXL_RV32)
 #else
@@ -27,6 +27,9 @@
 #include "exec/helper-proto.h"
 #include "exec/tlb-flags.h"
 #include "trace.h"
+#ifdef CONFIG_LINUX_USER
+#include "user/native-call.h"
+#endif
 
 /* Exceptions processing helpers */
 G_NORETURN void riscv_raise_exception(CPURISCVState *env,
@@ -718,3 +721,18 @@ target_ulong helper_hyp_hlvx_wu(CPURISCVState *env, target_ulong addr)
 }
 
 #endif /* !CONFIG_USER_ONLY */
+
+#ifdef CONFIG_LINUX_USER
+/* Return 1 if the function has been run on the host, 0 to emulate it */
+target_ulong helper_native_call(CPURISCVState *env, uint32_t id)
+{
+    abi_ulong ret;
+
+    if (!native_call_run(id, env->gpr[xA0], env->gpr[xA1], env->gpr[xA2],
+                         &ret)) {
+        return 0;
+    }
+    env->gpr[xA0] = (abi_long)ret;
+    return 1;
+}
+#endif
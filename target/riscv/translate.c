@@ -27,6 +27,9 @@
 #include "exec/translation-block.h"
 #include "exec/log.h"
 #include "semihosting/semihost.h"
+#ifdef CONFIG_LINUX_USER
+#include "user/native-call.h"
+#endif
 
 #include "internals.h"
 
@@ -75,6 +78,8 @@ typedef struct DisasContext {
      * to reset this known value.
      */
     int frm;
+    /* The value of CSR_FRM, which is part of the TB state. */
+    int tb_frm;
     RISCVMXL ol;
     bool virt_inst_excp;
     bool virt_enabled;
@@ -109,8 +114,6 @@ typedef struct DisasContext {
     bool ztso;
     /* Use icount trigger for native debug */
     bool itrigger;
-    /* FRM is known to contain a valid value. */
-    bool frm_valid;
     bool insn_start_updated;
     const GPtrArray *decoders;
     /* zicfilp extension. fcfi_enabled, lp expected or not */
@@ -729,34 +732,61 @@ static void finalize_rvv_inst(DisasContext *ctx)
     ctx->vstart_eq_zero = true;
 }
 
+static int riscv_softrm(int rm)
+{
+    switch (rm) {
+    case RISCV_FRM_RNE:
+        return float_round_nearest_even;
+    case RISCV_FRM_RTZ:
+        return float_round_to_zero;
+    case RISCV_FRM_RDN:
+        return float_round_down;
+    case RISCV_FRM_RUP:
+        return float_round_up;
+    case RISCV_FRM_RMM:
+        return float_round_ties_away;
+    case RISCV_FRM_ROD:
+        return float_round_to_odd;
+    default:
+        return -1;
+    }
+}
+
+/*
+ * Since frm is part of the TB state, the rounding mode is always known
+ * here and can be stored directly into fp_status.  The helpers are only
+ * used to raise ILLEGAL_INSN for a reserved rounding mode.
+ */
 static void gen_set_rm(DisasContext *ctx, int rm)
 {
+    int softrm;
+
+    if (rm == RISCV_FRM_DYN) {
+        rm = ctx->tb_frm;
+    }
     if (ctx->frm == rm) {
         return;
     }
     ctx->frm = rm;
 
-    if (rm == RISCV_FRM_DYN) {
-        /* The helper will return only if frm valid. */
-        ctx->frm_valid = true;
+    softrm = riscv_softrm(rm);
+    if (softrm < 0) {
+        /* The helper will raise ILLEGAL_INSN -- record binv for unwind. */
+        decode_save_opc(ctx, 0);
+        gen_helper_set_rounding_mode(tcg_env, tcg_constant_i32(rm));
+        return;
     }
-
-    /* The helper may raise ILLEGAL_INSN -- record binv for unwind. */
-    decode_save_opc(ctx, 0);
-    gen_helper_set_rounding_mode(tcg_env, tcg_constant_i32(rm));
+    tcg_gen_st8_i32(tcg_constant_i32(softrm), tcg_env,
+                    offsetof(CPURISCVState, fp_status.float_rounding_mode));
 }
 
 static void gen_set_rm_chkfrm(DisasContext *ctx, int rm)
 {
-    if (ctx->frm == rm && ctx->frm_valid) {
-        return;
+    /* Always validate frm, even if rm != DYN. */
+    if (riscv_softrm(ctx->tb_frm) < 0) {
+        rm = RISCV_FRM_DYN;
     }
-    ctx->frm = rm;
-    ctx->frm_valid = true;
-
-    /* The helper may raise ILLEGAL_INSN -- record binv for unwind. */
-    decode_save_opc(ctx, 0);
-    gen_helper_set_rounding_mode_chkfrm(tcg_env, tcg_constant_i32(rm));
+    gen_set_rm(ctx, rm);
 }
 
 static int ex_plus_1(DisasContext *ctx, int nf)
@@ -1291,6 +1321,7 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->virt_enabled = FIELD_EX32(tb_flags, TB_FLAGS, VIRT_ENABLED);
     ctx->misa_ext = env->misa_ext;
     ctx->frm = -1;  /* unknown rounding mode */
+    ctx->tb_frm = FIELD_EX64(ctx->base.tb->cs_base, TB_FLAGS2, FRM);
     ctx->cfg_ptr = &(cpu->cfg);
     ctx->vill = FIELD_EX32(tb_flags, TB_FLAGS, VILL);
     ctx->sew = FIELD_EX32(tb_flags, TB_FLAGS, SEW);
@@ -1339,11 +1370,47 @@ static void riscv_tr_insn_start(DisasContextBase *dcbase, CPUState *cpu)
     ctx->insn_start_updated = false;
 }
 
+#ifdef CONFIG_LINUX_USER
+/*
+ * At the entry of a guest library function that has a host implementation,
+ * try that first and return to the caller, else fall back to emulation.
+ */
+static void gen_native_call(DisasContext *ctx)
+{
+    int id = native_call_lookup(ctx->base.pc_next);
+    TCGLabel *emulate;
+    TCGv done;
+
+    if (id < 0) {
+        return;
+    }
+
+    emulate = gen_new_label();
+    done = tcg_temp_new();
+    gen_helper_native_call(done, tcg_env, tcg_constant_i32(id));
+    tcg_gen_brcondi_tl(TCG_COND_EQ, done, 0, emulate);
+
+    tcg_gen_andi_tl(cpu_pc, cpu_gpr[xRA], (target_ulong)-2);
+    if (get_xl(ctx) == MXL_RV32) {
+        tcg_gen_ext32s_tl(cpu_pc, cpu_pc);
+    }
+    lookup_and_goto_ptr(ctx);
+
+    gen_set_label(emulate);
+}
+#endif
+
 static void riscv_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
 {
     DisasContext *ctx = container_of(dcbase, DisasContext, base);
     CPURISCVState *env = cpu_env(cpu);
 
+#ifdef CONFIG_LINUX_USER
+    /* The host path would skip the lpad check at the function entry. */
+    if (unlikely(native_call_enabled) && !ctx->fcfi_enabled) {
+        gen_native_call(ctx);
+    }
+#endif
     decode_opc(env, ctx);
     ctx->base.pc_next += ctx->cur_insn_len;
 
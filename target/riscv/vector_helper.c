@@ -3147,12 +3147,69 @@ void HELPER(NAME)(void *vd, void *v0, void *vs1,          \
                       total_elems * ESZ);                 \
 }
 
+/*
+ * Unmasked operations on elements that are stored in memory order, i.e.
+ * all of them on little-endian hosts, are handed to the softfloat batch
+ * functions which compute a whole run of elements at once.
+ */
+#define VEXT_FP_BATCH 64
+
+static inline bool vext_fp_batch(uint32_t vm, uint32_t esz)
+{
+    return vm && (!HOST_BIG_ENDIAN || esz == 8);
+}
+
+#define OPFVV2_BATCH(NAME, ETYPE, OP)                               \
+static void do_batch_##NAME(void *vd, void *vs1, void *vs2,        \
+                            uint32_t i, uint32_t vl,               \
+                            CPURISCVState *env)                    \
+{                                                                  \
+    OP((ETYPE *)vd + i, (ETYPE *)vs2 + i, (ETYPE *)vs1 + i, vl - i, \
+       &env->fp_status);                                           \
+}
+
+#define GEN_VEXT_VV_ENV_BATCH(NAME, ESZ)                  \
+void HELPER(NAME)(void *vd, void *v0, void *vs1,          \
+                  void *vs2, CPURISCVState *env,          \
+                  uint32_t desc)                          \
+{                                                         \
+    uint32_t vm = vext_vm(desc);                          \
+    uint32_t vl = env->vl;                                \
+    uint32_t total_elems =                                \
+        vext_get_total_elems(env, desc, ESZ);             \
+    uint32_t vta = vext_vta(desc);                        \
+    uint32_t vma = vext_vma(desc);                        \
+    uint32_t i;                                           \
+                                                          \
+    VSTART_CHECK_EARLY_EXIT(env, vl);                     \
+                                                          \
+    if (vext_fp_batch(vm, ESZ)) {                         \
+        do_batch_##NAME(vd, vs1, vs2, env->vstart, vl, env); \
+    } else {                                              \
+        for (i = env->vstart; i < vl; i++) {              \
+            if (!vm && !vext_elem_mask(v0, i)) {          \
+                /* set masked-off elements to 1s */       \
+                vext_set_elems_1s(vd, vma, i * ESZ,       \
+                                  (i + 1) * ESZ);         \
+                continue;                                 \
+            }                                             \
+            do_##NAME(vd, vs1, vs2, i, env);              \
+        }                                                 \
+    }                                                     \
+    env->vstart = 0;                                      \
+    /* set tail elements to 1s */                         \
+    vext_set_elems_1s(vd, vta, vl * ESZ,                  \
+                      total_elems * ESZ);                 \
+}
+
 RVVCALL(OPFVV2, vfadd_vv_h, OP_UUU_H, H2, H2, H2, float16_add)
 RVVCALL(OPFVV2, vfadd_vv_w, OP_UUU_W, H4, H4, H4, float32_add)
 RVVCALL(OPFVV2, vfadd_vv_d, OP_UUU_D, H8, H8, H8, float64_add)
+OPFVV2_BATCH(vfadd_vv_w, float32, float32_add_batch)
+OPFVV2_BATCH(vfadd_vv_d, float64, float64_add_batch)
 GEN_VEXT_VV_ENV(vfadd_vv_h, 2)
-GEN_VEXT_VV_ENV(vfadd_vv_w, 4)
-GEN_VEXT_VV_ENV(vfadd_vv_d, 8)
+GEN_VEXT_VV_ENV_BATCH(vfadd_vv_w, 4)
+GEN_VEXT_VV_ENV_BATCH(vfadd_vv_d, 8)
 
 #define OPFVF2(NAME, TD, T1, T2, TX1, TX2, HD, HS2, OP)        \
 static void do_##NAME(void *vd, uint64_t s1, void *vs2, int i, \
@@ -3192,25 +3249,83 @@ void HELPER(NAME)(void *vd, void *v0, uint64_t s1,        \
                       total_elems * ESZ);                 \
 }
 
+/* The scalar operand is broadcast to VEXT_FP_BATCH elements at a time */
+#define OPFVF2_BATCH(NAME, ETYPE, OP)                               \
+static void do_batch_##NAME(void *vd, uint64_t s1, void *vs2,      \
+                            uint32_t i, uint32_t vl,               \
+                            CPURISCVState *env)                    \
+{                                                                  \
+    ETYPE b[VEXT_FP_BATCH];                                        \
+    uint32_t j, n;                                                 \
+                                                                   \
+    for (j = 0; j < VEXT_FP_BATCH; j++) {                          \
+        b[j] = make_##ETYPE(s1);                                   \
+    }                                                              \
+    for (; i < vl; i += n) {                                       \
+        n = MIN(vl - i, VEXT_FP_BATCH);                            \
+        OP((ETYPE *)vd + i, (ETYPE *)vs2 + i, b, n, &env->fp_status); \
+    }                                                              \
+}
+
+#define GEN_VEXT_VF_BATCH(NAME, ESZ)                      \
+void HELPER(NAME)(void *vd, void *v0, uint64_t s1,        \
+                  void *vs2, CPURISCVState *env,          \
+                  uint32_t desc)                          \
+{                                                         \
+    uint32_t vm = vext_vm(desc);                          \
+    uint32_t vl = env->vl;                                \
+    uint32_t total_elems =                                \
+        vext_get_total_elems(env, desc, ESZ);             \
+    uint32_t vta = vext_vta(desc);                        \
+    uint32_t vma = vext_vma(desc);                        \
+    uint32_t i;                                           \
+                                                          \
+    VSTART_CHECK_EARLY_EXIT(env, vl);                     \
+                                                          \
+    if (vext_fp_batch(vm, ESZ)) {                         \
+        do_batch_##NAME(vd, s1, vs2, env->vstart, vl, env); \
+    } else {                                              \
+        for (i = env->vstart; i < vl; i++) {              \
+            if (!vm && !vext_elem_mask(v0, i)) {          \
+                /* set masked-off elements to 1s */       \
+                vext_set_elems_1s(vd, vma, i * ESZ,       \
+                                  (i + 1) * ESZ);         \
+                continue;                                 \
+            }                                             \
+            do_##NAME(vd, s1, vs2, i, env);               \
+        }                                                 \
+    }                                                     \
+    env->vstart = 0;                                      \
+    /* set tail elements to 1s */                         \
+    vext_set_elems_1s(vd, vta, vl * ESZ,                  \
+                      total_elems * ESZ);                 \
+}
+
 RVVCALL(OPFVF2, vfadd_vf_h, OP_UUU_H, H2, H2, float16_add)
 RVVCALL(OPFVF2, vfadd_vf_w, OP_UUU_W, H4, H4, float32_add)
 RVVCALL(OPFVF2, vfadd_vf_d, OP_UUU_D, H8, H8, float64_add)
+OPFVF2_BATCH(vfadd_vf_w, float32, float32_add_batch)
+OPFVF2_BATCH(vfadd_vf_d, float64, float64_add_batch)
 GEN_VEXT_VF(vfadd_vf_h, 2)
-GEN_VEXT_VF(vfadd_vf_w, 4)
-GEN_VEXT_VF(vfadd_vf_d, 8)
+GEN_VEXT_VF_BATCH(vfadd_vf_w, 4)
+GEN_VEXT_VF_BATCH(vfadd_vf_d, 8)
 
 RVVCALL(OPFVV2, vfsub_vv_h, OP_UUU_H, H2, H2, H2, float16_sub)
 RVVCALL(OPFVV2, vfsub_vv_w, OP_UUU_W, H4, H4, H4, float32_sub)
 RVVCALL(OPFVV2, vfsub_vv_d, OP_UUU_D, H8, H8, H8, float64_sub)
+OPFVV2_BATCH(vfsub_vv_w, float32, float32_sub_batch)
+OPFVV2_BATCH(vfsub_vv_d, float64, float64_sub_batch)
 GEN_VEXT_VV_ENV(vfsub_vv_h, 2)
-GEN_VEXT_VV_ENV(vfsub_vv_w, 4)
-GEN_VEXT_VV_ENV(vfsub_vv_d, 8)
+GEN_VEXT_VV_ENV_BATCH(vfsub_vv_w, 4)
+GEN_VEXT_VV_ENV_BATCH(vfsub_vv_d, 8)
 RVVCALL(OPFVF2, vfsub_vf_h, OP_UUU_H, H2, H2, float16_sub)
 RVVCALL(OPFVF2, vfsub_vf_w, OP_UUU_W, H4, H4, float32_sub)
 RVVCALL(OPFVF2, vfsub_vf_d, OP_UUU_D, H8, H8, float64_sub)
+OPFVF2_BATCH(vfsub_vf_w, float32, float32_sub_batch)
+OPFVF2_BATCH(vfsub_vf_d, float64, float64_sub_batch)
 GEN_VEXT_VF(vfsub_vf_h, 2)
-GEN_VEXT_VF(vfsub_vf_w, 4)
-GEN_VEXT_VF(vfsub_vf_d, 8)
+GEN_VEXT_VF_BATCH(vfsub_vf_w, 4)
+GEN_VEXT_VF_BATCH(vfsub_vf_d, 8)
 
 static uint16_t float16_rsub(uint16_t a, uint16_t b, float_status *s)
 {
@@ -3321,28 +3436,36 @@ GEN_VEXT_VF(vfwsub_wf_w, 8)
 RVVCALL(OPFVV2, vfmul_vv_h, OP_UUU_H, H2, H2, H2, float16_mul)
 RVVCALL(OPFVV2, vfmul_vv_w, OP_UUU_W, H4, H4, H4, float32_mul)
 RVVCALL(OPFVV2, vfmul_vv_d, OP_UUU_D, H8, H8, H8, float64_mul)
+OPFVV2_BATCH(vfmul_vv_w, float32, float32_mul_batch)
+OPFVV2_BATCH(vfmul_vv_d, float64, float64_mul_batch)
 GEN_VEXT_VV_ENV(vfmul_vv_h, 2)
-GEN_VEXT_VV_ENV(vfmul_vv_w, 4)
-GEN_VEXT_VV_ENV(vfmul_vv_d, 8)
+GEN_VEXT_VV_ENV_BATCH(vfmul_vv_w, 4)
+GEN_VEXT_VV_ENV_BATCH(vfmul_vv_d, 8)
 RVVCALL(OPFVF2, vfmul_vf_h, OP_UUU_H, H2, H2, float16_mul)
 RVVCALL(OPFVF2, vfmul_vf_w, OP_UUU_W, H4, H4, float32_mul)
 RVVCALL(OPFVF2, vfmul_vf_d, OP_UUU_D, H8, H8, float64_mul)
+OPFVF2_BATCH(vfmul_vf_w, float32, float32_mul_batch)
+OPFVF2_BATCH(vfmul_vf_d, float64, float64_mul_batch)
 GEN_VEXT_VF(vfmul_vf_h, 2)
-GEN_VEXT_VF(vfmul_vf_w, 4)
-GEN_VEXT_VF(vfmul_vf_d, 8)
+GEN_VEXT_VF_BATCH(vfmul_vf_w, 4)
+GEN_VEXT_VF_BATCH(vfmul_vf_d, 8)
 
 RVVCALL(OPFVV2, vfdiv_vv_h, OP_UUU_H, H2, H2, H2, float16_div)
 RVVCALL(OPFVV2, vfdiv_vv_w, OP_UUU_W, H4, H4, H4, float32_div)
 RVVCALL(OPFVV2, vfdiv_vv_d, OP_UUU_D, H8, H8, H8, float64_div)
+OPFVV2_BATCH(vfdiv_vv_w, float32, float32_div_batch)
+OPFVV2_BATCH(vfdiv_vv_d, float64, float64_div_batch)
 GEN_VEXT_VV_ENV(vfdiv_vv_h, 2)
-GEN_VEXT_VV_ENV(vfdiv_vv_w, 4)
-GEN_VEXT_VV_ENV(vfdiv_vv_d, 8)
+GEN_VEXT_VV_ENV_BATCH(vfdiv_vv_w, 4)
+GEN_VEXT_VV_ENV_BATCH(vfdiv_vv_d, 8)
 RVVCALL(OPFVF2, vfdiv_vf_h, OP_UUU_H, H2, H2, float16_div)
 RVVCALL(OPFVF2, vfdiv_vf_w, OP_UUU_W, H4, H4, float32_div)
 RVVCALL(OPFVF2, vfdiv_vf_d, OP_UUU_D, H8, H8, float64_div)
+OPFVF2_BATCH(vfdiv_vf_w, float32, float32_div_batch)
+OPFVF2_BATCH(vfdiv_vf_d, float64, float64_div_batch)
 GEN_VEXT_VF(vfdiv_vf_h, 2)
-GEN_VEXT_VF(vfdiv_vf_w, 4)
-GEN_VEXT_VF(vfdiv_vf_d, 8)
+GEN_VEXT_VF_BATCH(vfdiv_vf_w, 4)
+GEN_VEXT_VF_BATCH(vfdiv_vf_d, 8)
 
 static uint16_t float16_rdiv(uint16_t a, uint16_t b, float_status *s)
 {
@@ -3414,12 +3537,24 @@ static uint64_t fmacc64(uint64_t a, uint64_t b, uint64_t d, float_status *s)
     return float64_muladd(a, b, d, 0, s);
 }
 
+/* vd[i] = vs2[i] * vs1[i] + vd[i] */
+#define OPFVV3_BATCH(NAME, ETYPE, OP)                               \
+static void do_batch_##NAME(void *vd, void *vs1, void *vs2,        \
+                            uint32_t i, uint32_t vl,               \
+                            CPURISCVState *env)                    \
+{                                                                  \
+    OP((ETYPE *)vd + i, (ETYPE *)vs2 + i, (ETYPE *)vs1 + i,        \
+       (ETYPE *)vd + i, vl - i, &env->fp_status);                  \
+}
+
 RVVCALL(OPFVV3, vfmacc_vv_h, OP_UUU_H, H2, H2, H2, fmacc16)
 RVVCALL(OPFVV3, vfmacc_vv_w, OP_UUU_W, H4, H4, H4, fmacc32)
 RVVCALL(OPFVV3, vfmacc_vv_d, OP_UUU_D, H8, H8, H8, fmacc64)
+OPFVV3_BATCH(vfmacc_vv_w, float32, float32_muladd_batch)
+OPFVV3_BATCH(vfmacc_vv_d, float64, float64_muladd_batch)
 GEN_VEXT_VV_ENV(vfmacc_vv_h, 2)
-GEN_VEXT_VV_ENV(vfmacc_vv_w, 4)
-GEN_VEXT_VV_ENV(vfmacc_vv_d, 8)
+GEN_VEXT_VV_ENV_BATCH(vfmacc_vv_w, 4)
+GEN_VEXT_VV_ENV_BATCH(vfmacc_vv_d, 8)
 
 #define OPFVF3(NAME, TD, T1, T2, TX1, TX2, HD, HS2, OP)           \
 static void do_##NAME(void *vd, uint64_t s1, void *vs2, int i,    \
@@ -3430,12 +3565,32 @@ static void do_##NAME(void *vd, uint64_t s1, void *vs2, int i,    \
     *((TD *)vd + HD(i)) = OP(s2, (TX1)(T1)s1, d, &env->fp_status);\
 }
 
+#define OPFVF3_BATCH(NAME, ETYPE, OP)                               \
+static void do_batch_##NAME(void *vd, uint64_t s1, void *vs2,      \
+                            uint32_t i, uint32_t vl,               \
+                            CPURISCVState *env)                    \
+{                                                                  \
+    ETYPE b[VEXT_FP_BATCH];                                        \
+    uint32_t j, n;                                                 \
+                                                                   \
+    for (j = 0; j < VEXT_FP_BATCH; j++) {                          \
+        b[j] = make_##ETYPE(s1);                                   \
+    }                                                              \
+    for (; i < vl; i += n) {                                       \
+        n = MIN(vl - i, VEXT_FP_BATCH);                            \
+        OP((ETYPE *)vd + i, (ETYPE *)vs2 + i, b, (ETYPE *)vd + i,  \
+           n, &env->fp_status);                                    \
+    }                                                              \
+}
+
 RVVCALL(OPFVF3, vfmacc_vf_h, OP_UUU_H, H2, H2, fmacc16)
 RVVCALL(OPFVF3, vfmacc_vf_w, OP_UUU_W, H4, H4, fmacc32)
 RVVCALL(OPFVF3, vfmacc_vf_d, OP_UUU_D, H8, H8, fmacc64)
+OPFVF3_BATCH(vfmacc_vf_w, float32, float32_muladd_batch)
+OPFVF3_BATCH(vfmacc_vf_d, float64, float64_muladd_batch)
 GEN_VEXT_VF(vfmacc_vf_h, 2)
-GEN_VEXT_VF(vfmacc_vf_w, 4)
-GEN_VEXT_VF(vfmacc_vf_d, 8)
+GEN_VEXT_VF_BATCH(vfmacc_vf_w, 4)
+GEN_VEXT_VF_BATCH(vfmacc_vf_d, 8)
 
 static uint16_t fnmacc16(uint16_t a, uint16_t b, uint16_t d, float_status *s)
 {
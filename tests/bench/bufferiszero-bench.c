@@ -9,32 +9,78 @@
 #include "qemu/cutils.h"
 #include "qemu/units.h"
 
-static void test(const void *opaque)
+#define MIN_LEN     (1 * KiB)
+#define MAX_LEN     (4 * MiB)
+#define N_LENS      7       /* MIN_LEN to MAX_LEN, in steps of 4x */
+#define MAX_ACCELS  16
+
+static double measure(const void *buf, size_t len)
 {
-    size_t max = 64 * KiB;
-    void *buf = g_malloc0(max);
-    int accel_index = 0;
+    double total = 0.0;
 
+    g_test_timer_start();
     do {
-        if (accel_index != 0) {
-            g_test_message("%s", "");  /* gnu_printf Werror for simple "" */
+        buffer_is_zero_ge256(buf, len);
+        total += len;
+    } while (g_test_timer_elapsed() < 0.5);
+
+    return total / MiB / g_test_timer_last();
+}
+
+static void test(const void *opaque)
+{
+    void *buf = g_malloc0(MAX_LEN);
+    double speed[MAX_ACCELS][N_LENS];
+    double best_time[2] = { 0.0, 0.0 };
+    unsigned best[2] = { 0, 0 };
+    unsigned n_accels;
+    size_t len;
+    int i;
+
+    /* The default selection, as done by the library at startup.  */
+    for (len = MIN_LEN; len <= MAX_LEN; len *= 4) {
+        g_test_message("buffer_is_zero default: %4zuKB %8.0f MB/sec",
+                       len / (size_t)KiB, measure(buf, len));
+    }
+
+    /* Every implementation usable on this host, at every size.  */
+    for (n_accels = 0; n_accels < MAX_ACCELS &&
+         test_buffer_is_zero_set_accel(n_accels, n_accels); n_accels++) {
+        g_test_message("%s", "");  /* gnu_printf Werror for simple "" */
+        for (len = MIN_LEN, i = 0; len <= MAX_LEN; len *= 4, i++) {
+            speed[n_accels][i] = measure(buf, len);
+            g_test_message("buffer_is_zero #%u: %4zuKB %8.0f MB/sec",
+                           n_accels, len / (size_t)KiB, speed[n_accels][i]);
+        }
+    }
+
+    /*
+     * Pick the best implementation for each size class, by total time
+     * spent scanning one buffer of each size in the class.
+     */
+    for (unsigned a = 0; a < n_accels; a++) {
+        double t[2] = { 0.0, 0.0 };
+
+        for (len = MIN_LEN, i = 0; len <= MAX_LEN; len *= 4, i++) {
+            t[len >= BUFFER_IS_ZERO_LARGE] += len / speed[a][i];
         }
-        for (size_t len = 1 * KiB; len <= max; len *= 4) {
-            double total = 0.0;
-
-            g_test_timer_start();
-            do {
-                buffer_is_zero_ge256(buf, len);
-                total += len;
-            } while (g_test_timer_elapsed() < 0.5);
-
-            total /= MiB;
-            g_test_message("buffer_is_zero #%d: %2zuKB %8.0f MB/sec",
-                           accel_index, len / (size_t)KiB,
-                           total / g_test_timer_last());
+        for (int c = 0; c < 2; c++) {
+            if (best_time[c] == 0.0 || t[c] < best_time[c]) {
+                best_time[c] = t[c];
+                best[c] = a;
+            }
         }
-        accel_index++;
-    } while (test_buffer_is_zero_next_accel());
+    }
+
+    g_test_message("%s", "");
+    g_test_message("best for < %zuKB: #%u, for >= %zuKB: #%u",
+                   (size_t)BUFFER_IS_ZERO_LARGE / KiB, best[0],
+                   (size_t)BUFFER_IS_ZERO_LARGE / KiB, best[1]);
+    g_assert(test_buffer_is_zero_set_accel(best[0], best[1]));
+    for (len = MIN_LEN, i = 0; len <= MAX_LEN; len *= 4, i++) {
+        g_test_message("buffer_is_zero best:    %4zuKB %8.0f MB/sec",
+                       len / (size_t)KiB, measure(buf, len));
+    }
 
     g_free(buf);
 }
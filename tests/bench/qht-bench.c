@@ -11,6 +11,7 @@
 #include "qemu/rcu.h"
 #include "qemu/xxhash.h"
 #include "qemu/memalign.h"
+#include "qemu/timer.h"
 
 struct thread_stats {
     size_t rd;
@@ -21,6 +22,7 @@ struct thread_stats {
     size_t not_rm;
     size_t rz;
     size_t not_rz;
+    int64_t max_in_ns;
 };
 
 struct thread_info {
@@ -61,6 +63,7 @@ static double resize_rate; /* 0.0 to 1.0 */
 static unsigned int n_rz_threads = 1;
 static QemuThread *rz_threads;
 static bool precompute_hash;
+static bool grow_test;
 
 static double update_rate; /* 0.0 to 1.0 */
 static uint64_t update_threshold;
@@ -93,7 +96,12 @@ static const char commands_string[] =
     " -R = enable auto-resize\n"
     " -S = resize rate (0.0 to 100.0)\n"
     " -D = delay (in us) between potential resizes\n"
-    " -N = number of resize threads";
+    " -N = number of resize threads\n"
+    "\n"
+    " -G = grow under load: start from an empty table with auto-resize on,\n"
+    "      only insert during updates, and have resize threads (-S,-D,-N)\n"
+    "      reset the table so that it keeps growing. Reports the worst-case\n"
+    "      insertion latency";
 
 static void usage_complete(int argc, char *argv[])
 {
@@ -140,7 +148,14 @@ static void do_rz(struct thread_info *info)
     struct thread_stats *stats = &info->stats;
     uint64_t r = info->seed - 1;
 
-    if (r < resize_threshold) {
+    if (grow_test) {
+        if (r < resize_threshold) {
+            qht_reset_size(&ht, 0);
+            stats->rz++;
+        } else {
+            stats->not_rz++;
+        }
+    } else if (r < resize_threshold) {
         size_t size = info->resize_down ? resize_min : resize_max;
         bool resized;
 
@@ -181,7 +196,15 @@ static void do_rw(struct thread_info *info)
             bool written = false;
 
             if (qht_lookup(&ht, p, hash) == NULL) {
-                written = qht_insert(&ht, p, hash, NULL);
+                if (grow_test) {
+                    int64_t t0 = get_clock();
+
+                    written = qht_insert(&ht, p, hash, NULL);
+                    stats->max_in_ns = MAX(stats->max_in_ns,
+                                           get_clock() - t0);
+                } else {
+                    written = qht_insert(&ht, p, hash, NULL);
+                }
             }
             if (written) {
                 stats->in++;
@@ -200,7 +223,8 @@ static void do_rw(struct thread_info *info)
                 stats->not_rm++;
             }
         }
-        info->write_op = !info->write_op;
+        /* when growing the table, all updates are insertions */
+        info->write_op = grow_test || !info->write_op;
     }
 }
 
@@ -276,6 +300,7 @@ static void pr_params(void)
     printf(" initial size hint: %zu\n", qht_n_elems);
     printf(" auto-resize:       %s\n",
            qht_mode & QHT_MODE_AUTO_RESIZE ? "on" : "off");
+    printf(" grow under load:   %s\n", grow_test ? "on" : "off");
     if (resize_rate) {
         printf(" resize_rate:       %f%%\n", resize_rate * 100.0);
         printf(" resize range:      %zu-%zu\n", resize_min, resize_max);
@@ -384,6 +409,8 @@ static void add_stats(struct thread_stats *s, struct thread_info *info, int n)
 
         s->rz += stats->rz;
         s->not_rz += stats->not_rz;
+
+        s->max_in_ns = MAX(s->max_in_ns, stats->max_in_ns);
     }
 }
 
@@ -401,6 +428,9 @@ static void pr_stats(void)
         printf(" Resizes:           %zu (%.2f%% of %zu)\n",
                s.rz, (double)s.rz / (s.rz + s.not_rz) * 100, s.rz + s.not_rz);
     }
+    if (grow_test) {
+        printf(" Max insert time:   %.2f us\n", (double)s.max_in_ns / 1e3);
+    }
 
     printf(" Read:              %.2f M (%.2f%% of %.2fM)\n",
            (double)s.rd / 1e6,
@@ -445,7 +475,7 @@ static void parse_args(int argc, char *argv[])
     int c;
 
     for (;;) {
-        c = getopt(argc, argv, "d:D:g:k:K:l:hn:N:o:pr:Rs:S:u:");
+        c = getopt(argc, argv, "d:D:g:Gk:K:l:hn:N:o:pr:Rs:S:u:");
         if (c < 0) {
             break;
         }
@@ -463,6 +493,9 @@ static void parse_args(int argc, char *argv[])
             qht_n_elems = atol(optarg);
             init_size = atol(optarg);
             break;
+        case 'G':
+            grow_test = true;
+            break;
         case 'h':
             usage_complete(argc, argv);
             exit(0);
@@ -516,6 +549,11 @@ static void parse_args(int argc, char *argv[])
 int main(int argc, char *argv[])
 {
     parse_args(argc, argv);
+    if (grow_test) {
+        qht_mode |= QHT_MODE_AUTO_RESIZE;
+        qht_n_elems = 0;
+        init_size = 0;
+    }
     htable_init();
     create_threads();
     run_test();
@@ -0,0 +1,62 @@
+/*
+ * Check syscalls that linux-user may pass straight to the host.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static void test_results(void)
+{
+    char tempname[] = "/tmp/.csyscallXXXXXX";
+    int pipefd[2];
+    struct stat st;
+    int fd, ret;
+
+    /* umask returns the previous mask */
+    umask(022);
+    assert(umask(077) == 022);
+    assert(umask(022) == 077);
+
+    assert(getpgid(0) == getpgrp());
+    assert(getsid(0) == getsid(getpid()));
+    assert(syscall(SYS_gettid) > 0);
+
+    /* Host errno values must still be converted */
+    errno = 0;
+    assert(fsync(-1) == -1 && errno == EBADF);
+    assert(pipe(pipefd) == 0);
+    errno = 0;
+    assert(lseek(pipefd[0], 0, SEEK_SET) == -1 && errno == ESPIPE);
+    close(pipefd[0]);
+    close(pipefd[1]);
+
+    fd = mkstemp(tempname);
+    assert(fd != -1);
+    ret = unlink(tempname);
+    assert(ret == 0);
+
+    assert(ftruncate(fd, 4096) == 0);
+    assert(lseek(fd, 0, SEEK_END) == 4096);
+    assert(lseek(fd, -96, SEEK_CUR) == 4000);
+    assert(fchmod(fd, 0600) == 0);
+    assert(fstat(fd, &st) == 0);
+    assert((st.st_mode & 0777) == 0600 && st.st_size == 4096);
+    assert(flock(fd, LOCK_EX) == 0);
+    assert(flock(fd, LOCK_UN) == 0);
+    assert(fdatasync(fd) == 0);
+    assert(fsync(fd) == 0);
+    close(fd);
+}
+
+int main(void)
+{
+    test_results();
+    return EXIT_SUCCESS;
+}
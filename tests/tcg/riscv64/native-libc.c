@@ -0,0 +1,114 @@
+/*
+ * Check the string functions that -native-libc runs on the host.
+ *
+ * The test is run both with and without -native-libc, and the output
+ * of the two runs must match.  The -d page log of the second run must
+ * show that the host functions were used.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static unsigned sum(const unsigned char *p, size_t len)
+{
+    unsigned s = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        s = s * 31 + p[i];
+    }
+    return s;
+}
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+static void test_copy(void)
+{
+    static unsigned char src[4096], dst[4096];
+    size_t i;
+
+    for (i = 0; i < sizeof(src); i++) {
+        src[i] = i * 7 + 3;
+    }
+
+    assert(memcpy(dst, src, sizeof(src)) == dst);
+    assert(!memcmp(dst, src, sizeof(src)));
+    printf("memcpy: %08x\n", sum(dst, sizeof(dst)));
+
+    /* Overlapping moves in both directions */
+    assert(memmove(dst + 1, dst, 1000) == dst + 1);
+    for (i = 0; i < 1000; i++) {
+        assert(dst[i + 1] == src[i]);
+    }
+    printf("memmove up: %08x\n", sum(dst, sizeof(dst)));
+
+    memcpy(dst, src, sizeof(src));
+    assert(memmove(dst, dst + 17, 2000) == dst);
+    for (i = 0; i < 2000; i++) {
+        assert(dst[i] == src[i + 17]);
+    }
+    printf("memmove down: %08x\n", sum(dst, sizeof(dst)));
+
+    assert(memset(dst + 5, 0xa5, 333) == dst + 5);
+    for (i = 5; i < 338; i++) {
+        assert(dst[i] == 0xa5);
+    }
+    printf("memset: %08x\n", sum(dst, sizeof(dst)));
+}
+
+static void test_memcmp(void)
+{
+    unsigned char a[64], b[64];
+
+    memset(a, 0x40, sizeof(a));
+    memset(b, 0x40, sizeof(b));
+    assert(memcmp(a, b, sizeof(a)) == 0);
+
+    /* Bytes compare as unsigned char */
+    b[40] = 0x80;
+    assert(memcmp(a, b, sizeof(a)) < 0);
+    assert(memcmp(b, a, sizeof(a)) > 0);
+    assert(memcmp(a, b, 40) == 0);
+    printf("memcmp: %d %d %d\n", sign(memcmp(a, b, sizeof(a))),
+           sign(memcmp(b, a, sizeof(a))), sign(memcmp(a, b, 40)));
+}
+
+static void test_strlen(void)
+{
+    long page = sysconf(_SC_PAGESIZE);
+    char *p;
+
+    p = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(p != MAP_FAILED);
+
+    /* A string crossing into the second page */
+    memset(p, 'x', 2 * page);
+    p[page + 10] = 0;
+    assert(strlen(p + page - 100) == 110);
+
+    /* A string ending right before an unmapped page */
+    assert(munmap(p + page, page) == 0);
+    p[page - 1] = 0;
+    assert(strlen(p + page - 50) == 49);
+    assert(strlen(p + page - 1) == 0);
+    printf("strlen: %zu %zu\n", strlen(p), strlen(p + page - 50));
+
+    munmap(p, page);
+}
+
+int main(void)
+{
+    test_copy();
+    test_memcmp();
+    test_strlen();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/*
+ * Check clock_gettime and gettimeofday through the vdso.
+ *
+ * The vdso extrapolates from the time data page that QEMU publishes.
+ * The result must never go backwards and must stay close to what the
+ * syscalls return.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <assert.h>
+#include <elf.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/auxv.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+/* How far apart the vdso and the syscall may be. */
+#define MAX_DIFF_NS     (10 * 1000 * 1000LL)
+/* How long to keep reading the clocks. */
+#define RUN_NS          (50 * 1000 * 1000LL)
+
+typedef int clock_gettime_fn(clockid_t, struct timespec *);
+typedef int gettimeofday_fn(struct timeval *, void *);
+
+static clock_gettime_fn *vdso_clock_gettime;
+static gettimeofday_fn *vdso_gettimeofday;
+
+static void *vdso_sym(const char *name)
+{
+    uintptr_t base = getauxval(AT_SYSINFO_EHDR);
+    const ElfW(Ehdr) *ehdr = (const ElfW(Ehdr) *)base;
+    const ElfW(Phdr) *phdr = (const ElfW(Phdr) *)(base + ehdr->e_phoff);
+    const ElfW(Dyn) *dyn = NULL;
+    const ElfW(Sym) *symtab = NULL;
+    const Elf32_Word *hash = NULL;
+    const char *strtab = NULL;
+    uintptr_t load_offset = 0;
+    unsigned i;
+
+    assert(base);
+    for (i = 0; i < ehdr->e_phnum; i++) {
+        if (phdr[i].p_type == PT_LOAD) {
+            load_offset = base + phdr[i].p_offset - phdr[i].p_vaddr;
+        } else if (phdr[i].p_type == PT_DYNAMIC) {
+            dyn = (const ElfW(Dyn) *)(base + phdr[i].p_offset);
+        }
+    }
+    assert(dyn);
+
+    for (; dyn->d_tag != DT_NULL; dyn++) {
+        switch (dyn->d_tag) {
+        case DT_SYMTAB:
+            symtab = (const ElfW(Sym) *)(dyn->d_un.d_ptr + load_offset);
+            break;
+        case DT_STRTAB:
+            strtab = (const char *)(dyn->d_un.d_ptr + load_offset);
+            break;
+        case DT_HASH:
+            hash = (const Elf32_Word *)(dyn->d_un.d_ptr + load_offset);
+            break;
+        }
+    }
+    assert(symtab && strtab && hash);
+
+    /* The second word of DT_HASH is the number of symbols. */
+    for (i = 0; i < hash[1]; i++) {
+        if (symtab[i].st_shndx != SHN_UNDEF &&
+            ELF64_ST_TYPE(symtab[i].st_info) == STT_FUNC &&
+            !strcmp(strtab + symtab[i].st_name, name)) {
+            return (void *)(symtab[i].st_value + load_offset);
+        }
+    }
+    return NULL;
+}
+
+static long long ts_ns(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static long long tv_ns(const struct timeval *tv)
+{
+    return tv->tv_sec * 1000000000LL + tv->tv_usec * 1000LL;
+}
+
+static long long sys_clock(clockid_t clk)
+{
+    struct timespec ts;
+
+    assert(syscall(SYS_clock_gettime, clk, &ts) == 0);
+    return ts_ns(&ts);
+}
+
+static long long sys_gettimeofday(void)
+{
+    struct timeval tv;
+
+    assert(syscall(SYS_gettimeofday, &tv, NULL) == 0);
+    return tv_ns(&tv);
+}
+
+static void check_bounds(const char *what, long long before, long long now,
+                         long long after)
+{
+    if (now < before - MAX_DIFF_NS || now > after + MAX_DIFF_NS) {
+        fprintf(stderr, "%s: %lld not within [%lld, %lld]\n",
+                what, now, before, after);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void check_clock(clockid_t clk, const char *name)
+{
+    long long start = sys_clock(CLOCK_MONOTONIC);
+    long long prev = 0, before, now, after;
+    struct timespec ts;
+
+    do {
+        before = sys_clock(clk);
+        assert(vdso_clock_gettime(clk, &ts) == 0);
+        now = ts_ns(&ts);
+        after = sys_clock(clk);
+
+        if (now < prev) {
+            fprintf(stderr, "%s went back from %lld to %lld\n",
+                    name, prev, now);
+            exit(EXIT_FAILURE);
+        }
+        prev = now;
+        check_bounds(name, before, now, after);
+    } while (sys_clock(CLOCK_MONOTONIC) - start < RUN_NS);
+}
+
+static void check_gettimeofday(void)
+{
+    long long start = sys_clock(CLOCK_MONOTONIC);
+    long long prev = 0, before, now, after;
+    struct timeval tv;
+
+    do {
+        before = sys_gettimeofday();
+        assert(vdso_gettimeofday(&tv, NULL) == 0);
+        now = tv_ns(&tv);
+        after = sys_gettimeofday();
+
+        if (now < prev) {
+            fprintf(stderr, "gettimeofday went back from %lld to %lld\n",
+                    prev, now);
+            exit(EXIT_FAILURE);
+        }
+        prev = now;
+        check_bounds("gettimeofday", before, now, after);
+    } while (sys_clock(CLOCK_MONOTONIC) - start < RUN_NS);
+}
+
+int main(void)
+{
+    vdso_clock_gettime = vdso_sym("__vdso_clock_gettime");
+    vdso_gettimeofday = vdso_sym("__vdso_gettimeofday");
+    assert(vdso_clock_gettime && vdso_gettimeofday);
+
+    check_clock(CLOCK_MONOTONIC, "CLOCK_MONOTONIC");
+    check_clock(CLOCK_REALTIME, "CLOCK_REALTIME");
+    check_gettimeofday();
+    return EXIT_SUCCESS;
+}
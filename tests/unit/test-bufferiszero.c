@@ -56,6 +56,20 @@ static void test_1(void)
             }
         }
     }
+
+    /* Tests around the size where large buffers get special treatment.  */
+    for (s = BUFFER_IS_ZERO_LARGE - 64; s <= BUFFER_IS_ZERO_LARGE + 64;
+         s += 16) {
+        g_assert(buffer_is_zero(buffer + 1, s));
+        for (o = 0; o < s; o += 4093) {
+            buffer[1 + o] = 1;
+            g_assert(!buffer_is_zero(buffer + 1, s));
+            buffer[1 + o] = 0;
+        }
+        buffer[s] = 1;
+        g_assert(!buffer_is_zero(buffer + 1, s));
+        buffer[s] = 0;
+    }
 }
 
 static void test_2(void)
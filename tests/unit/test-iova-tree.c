@@ -0,0 +1,168 @@
+/*
+ * Test IOVA trees
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/iova-tree.h"
+
+static int alloc(IOVATree *tree, hwaddr taddr, hwaddr size, hwaddr begin,
+                 hwaddr last, hwaddr *iova)
+{
+    DMAMap map = {
+        .translated_addr = taddr,
+        .size = size,
+        .perm = IOMMU_RW,
+    };
+    int ret = iova_tree_alloc_map(tree, &map, begin, last);
+
+    *iova = map.iova;
+    return ret;
+}
+
+static void remove_iova(IOVATree *tree, hwaddr iova, hwaddr size)
+{
+    DMAMap map = {
+        .iova = iova,
+        .size = size,
+    };
+
+    iova_tree_remove(tree, map);
+}
+
+static void test_alloc_first_fit(void)
+{
+    IOVATree *tree = iova_tree_new();
+    hwaddr iova;
+
+    g_assert_cmpint(alloc(tree, 0x10000, 0xfff, 0x1000, 0xffffff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0x1000);
+    g_assert_cmpint(alloc(tree, 0x20000, 0xfff, 0x1000, 0xffffff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0x2000);
+    g_assert_cmpint(alloc(tree, 0x30000, 0x1fff, 0x1000, 0xffffff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0x3000);
+
+    /* A hole that is too small is skipped, an exact fit is used */
+    remove_iova(tree, 0x2000, 0xfff);
+    g_assert_cmpint(alloc(tree, 0x40000, 0x1fff, 0x1000, 0xffffff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0x5000);
+    g_assert_cmpint(alloc(tree, 0x50000, 0xfff, 0x1000, 0xffffff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0x2000);
+
+    /* Freed ranges are merged with their neighbours */
+    remove_iova(tree, 0x1000, 0xfff);
+    remove_iova(tree, 0x2000, 0xfff);
+    remove_iova(tree, 0x3000, 0x1fff);
+    g_assert_cmpint(alloc(tree, 0x60000, 0x3fff, 0x1000, 0xffffff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0x1000);
+
+    iova_tree_destroy(tree);
+}
+
+static void test_alloc_limits(void)
+{
+    IOVATree *tree = iova_tree_new();
+    hwaddr iova;
+
+    g_assert_cmpint(alloc(tree, 0, 0xfff, 0x2000, 0x1000, &iova),
+                    ==, IOVA_ERR_INVALID);
+
+    g_assert_cmpint(alloc(tree, 0, 0xfff, 0x1800, 0x3fff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0x1800);
+    g_assert_cmpint(alloc(tree, 0, 0x17ff, 0x1800, 0x3fff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0x2800);
+    g_assert_cmpint(alloc(tree, 0, 0, 0x1800, 0x3fff, &iova),
+                    ==, IOVA_ERR_NOMEM);
+
+    /* Space below iova_begin is still free for other callers */
+    g_assert_cmpint(alloc(tree, 0, 0x17ff, 0, 0x3fff, &iova),
+                    ==, IOVA_OK);
+    g_assert_cmphex(iova, ==, 0);
+
+    iova_tree_destroy(tree);
+}
+
+static void test_find_iova(void)
+{
+    IOVATree *tree = iova_tree_new();
+    DMAMap needle = { .size = 0 };
+    const DMAMap *map;
+    hwaddr iova;
+
+    for (int i = 0; i < 64; i++) {
+        g_assert_cmpint(alloc(tree, 0x100000 * (64 - i), 0xffff, 0x1000,
+                              HWADDR_MAX, &iova), ==, IOVA_OK);
+    }
+
+    needle.translated_addr = 0x100000 * 10 + 0x1234;
+    map = iova_tree_find_iova(tree, &needle);
+    g_assert_nonnull(map);
+    g_assert_cmphex(map->translated_addr, ==, 0x100000 * 10);
+    g_assert_cmphex(map->iova, ==, 0x1000 + 0x10000 * 54);
+
+    needle.translated_addr = 0x100000 * 10 + 0x10000;
+    g_assert_null(iova_tree_find_iova(tree, &needle));
+
+    remove_iova(tree, map->iova, 0);
+    needle.translated_addr = 0x100000 * 10;
+    g_assert_null(iova_tree_find_iova(tree, &needle));
+
+    iova_tree_destroy(tree);
+}
+
+static void test_alloc_random(void)
+{
+    IOVATree *tree = iova_tree_new();
+    hwaddr iovas[256] = { 0 };
+    hwaddr sizes[256] = { 0 };
+    bool mapped[256] = { false };
+
+    for (int it = 0; it < 10000; it++) {
+        int i = g_test_rand_int_range(0, ARRAY_SIZE(iovas));
+
+        if (mapped[i]) {
+            remove_iova(tree, iovas[i], sizes[i]);
+            mapped[i] = false;
+            continue;
+        }
+
+        sizes[i] = g_test_rand_int_range(0, 0x10000);
+        if (alloc(tree, i, sizes[i], 0x1000, 0xffffff, &iovas[i]) != IOVA_OK) {
+            continue;
+        }
+        mapped[i] = true;
+
+        g_assert_cmphex(iovas[i], >=, 0x1000);
+        g_assert_cmphex(iovas[i] + sizes[i], <=, 0xffffff);
+        for (int j = 0; j < ARRAY_SIZE(iovas); j++) {
+            if (j != i && mapped[j]) {
+                g_assert(iovas[i] + sizes[i] < iovas[j] ||
+                         iovas[j] + sizes[j] < iovas[i]);
+            }
+        }
+    }
+
+    iova_tree_destroy(tree);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/iova-tree/alloc-first-fit", test_alloc_first_fit);
+    g_test_add_func("/iova-tree/alloc-limits", test_alloc_limits);
+    g_test_add_func("/iova-tree/find-iova", test_find_iova);
+    g_test_add_func("/iova-tree/alloc-random", test_alloc_random);
+
+    return g_test_run();
+}
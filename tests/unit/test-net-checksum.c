@@ -0,0 +1,82 @@
+/*
+ * Test Internet checksum computation
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "net/checksum.h"
+
+/* The 16-bit word at a time definition from RFC 1071 */
+static uint16_t checksum_bytewise(const uint8_t *buf, int len, int seq)
+{
+    uint32_t sum = 0;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        sum += (i + seq) & 1 ? buf[i] : buf[i] << 8;
+    }
+
+    return net_checksum_finish(sum);
+}
+
+static void test_checksum_rfc1071(void)
+{
+    /* Example from RFC 1071, section 3 */
+    uint8_t data[] = { 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7 };
+
+    g_assert_cmphex(net_checksum_finish(net_checksum_add(sizeof(data), data)),
+                    ==, (uint16_t)~0xddf2);
+}
+
+static void check_random(void)
+{
+    g_autofree uint8_t *buf = g_malloc(65536 + 16);
+    int i;
+
+    for (i = 0; i < 65536 + 16; i++) {
+        buf[i] = g_test_rand_int();
+    }
+
+    for (i = 0; i < 2000; i++) {
+        int len = g_test_rand_int_range(0, i < 100 ? 65536 : 512);
+        int ofs = g_test_rand_int_range(0, 16);
+        int seq = g_test_rand_int_range(0, 2);
+
+        g_assert_cmphex(net_checksum_finish(net_checksum_add_cont(len,
+                                                                  buf + ofs,
+                                                                  seq)),
+                        ==, checksum_bytewise(buf + ofs, len, seq));
+    }
+}
+
+static void check_zero(void)
+{
+    uint8_t zero[1500] = { 0 };
+    uint8_t ones[1500];
+
+    memset(ones, 0xff, sizeof(ones));
+
+    /* Only an all-zero buffer sums to zero; all ones sum to negative zero */
+    g_assert_cmphex(net_checksum_add(sizeof(zero), zero), ==, 0);
+    g_assert_cmphex(net_checksum_finish(net_checksum_add(sizeof(ones), ones)),
+                    ==, 0);
+}
+
+/* Check every implementation usable on this host, fastest first */
+static void test_checksum_accel(void)
+{
+    do {
+        check_random();
+        check_zero();
+    } while (test_net_checksum_next_accel());
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/net/checksum/rfc1071", test_checksum_rfc1071);
+    g_test_add_func("/net/checksum/accel", test_checksum_accel);
+    return g_test_run();
+}
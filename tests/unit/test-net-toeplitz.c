@@ -0,0 +1,99 @@
+/*
+ * Test Toeplitz hashing
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "net/checksum.h"
+
+/* Verification suite from the Microsoft RSS specification */
+static uint8_t test_key[40] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+    0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+    0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+    0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+    0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+typedef struct {
+    uint8_t input[36];
+    size_t len;
+    uint32_t hash;
+} ToeplitzTest;
+
+static const ToeplitzTest test_data[] = {
+    /* 66.9.149.187:2794 -> 161.142.100.80:1766 */
+    {
+        .input = { 66, 9, 149, 187, 161, 142, 100, 80 },
+        .len = 8,
+        .hash = 0x323e8fc2,
+    },
+    {
+        .input = { 66, 9, 149, 187, 161, 142, 100, 80,
+                   0x0a, 0xea, 0x06, 0xe6 },
+        .len = 12,
+        .hash = 0x51ccc178,
+    },
+    /* [3ffe:2501:200:1fff::7]:2794 -> [3ffe:2501:200:3::1]:1766 */
+    {
+        .input = { 0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x1f, 0xff,
+                   0, 0, 0, 0, 0, 0, 0, 0x07,
+                   0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x00, 0x03,
+                   0, 0, 0, 0, 0, 0, 0, 0x01 },
+        .len = 32,
+        .hash = 0x2cc18cd5,
+    },
+    {
+        .input = { 0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x1f, 0xff,
+                   0, 0, 0, 0, 0, 0, 0, 0x07,
+                   0x3f, 0xfe, 0x25, 0x01, 0x02, 0x00, 0x00, 0x03,
+                   0, 0, 0, 0, 0, 0, 0, 0x01,
+                   0x0a, 0xea, 0x06, 0xe6 },
+        .len = 36,
+        .hash = 0x40207d3d,
+    },
+};
+
+static void test_toeplitz_vectors(void)
+{
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(test_data); i++) {
+        g_assert_cmphex(net_toeplitz_hash(test_key, test_data[i].input,
+                                          test_data[i].len),
+                        ==, test_data[i].hash);
+    }
+}
+
+static void test_toeplitz_bitwise(void)
+{
+    uint8_t input[36];
+    int i, len;
+
+    for (i = 0; i < 1000; i++) {
+        for (len = 0; len < sizeof(input); len++) {
+            input[len] = g_test_rand_int();
+        }
+
+        /* Compare with the bit-at-a-time version, including partial words */
+        for (len = 0; len <= sizeof(input); len++) {
+            net_toeplitz_key key;
+            uint32_t expected = 0;
+
+            net_toeplitz_key_init(&key, test_key);
+            net_toeplitz_add(&expected, input, len, &key);
+            g_assert_cmphex(net_toeplitz_hash(test_key, input, len),
+                            ==, expected);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/net/toeplitz/vectors", test_toeplitz_vectors);
+    g_test_add_func("/net/toeplitz/bitwise", test_toeplitz_bitwise);
+    return g_test_run();
+}
@@ -28,6 +28,15 @@
 
 typedef bool (*biz_accel_fn)(const void *, size_t);
 
+/*
+ * Buffers of at least BUFFER_IS_ZERO_LARGE bytes are unlikely to be reused
+ * from the cache once scanned, and are handed to the accelerator selected
+ * by best_accel_large().  Those accelerators prefetch BIZ_PREFETCH_DISTANCE
+ * bytes ahead with a non-temporal hint, so that the scan neither stalls on
+ * memory nor evicts the rest of QEMU's working set.
+ */
+#define BIZ_PREFETCH_DISTANCE  1024
+
 static bool buffer_is_zero_int_lt256(const void *buf, size_t len)
 {
     uint64_t t;
@@ -84,8 +93,17 @@ static bool buffer_is_zero_int_ge256(const void *buf, size_t len)
 #include "host/bufferiszero.c.inc"
 
 static biz_accel_fn buffer_is_zero_accel;
+static biz_accel_fn buffer_is_zero_accel_large;
 static unsigned accel_index;
 
+static inline bool buffer_is_zero_accel_dispatch(const void *buf, size_t len)
+{
+    if (unlikely(len >= BUFFER_IS_ZERO_LARGE)) {
+        return buffer_is_zero_accel_large(buf, len);
+    }
+    return buffer_is_zero_accel(buf, len);
+}
+
 bool buffer_is_zero_ool(const void *buf, size_t len)
 {
     if (unlikely(len == 0)) {
@@ -100,27 +118,48 @@ bool buffer_is_zero_ool(const void *buf, size_t len)
     }
 
     if (likely(len >= 256)) {
-        return buffer_is_zero_accel(buf, len);
+        return buffer_is_zero_accel_dispatch(buf, len);
     }
     return buffer_is_zero_int_lt256(buf, len);
 }
 
 bool buffer_is_zero_ge256(const void *buf, size_t len)
 {
-    return buffer_is_zero_accel(buf, len);
+    return buffer_is_zero_accel_dispatch(buf, len);
 }
 
+/*
+ * The accelerators usable on this host are accel_table[0] up to
+ * accel_table[best_accel_large()], which is always at least best_accel().
+ */
 bool test_buffer_is_zero_next_accel(void)
 {
     if (accel_index != 0) {
         buffer_is_zero_accel = accel_table[--accel_index];
+        buffer_is_zero_accel_large = buffer_is_zero_accel;
         return true;
     }
     return false;
 }
 
+bool test_buffer_is_zero_set_accel(unsigned index, unsigned index_large)
+{
+    unsigned max = best_accel_large();
+
+    if (index > max || index_large > max) {
+        return false;
+    }
+    buffer_is_zero_accel = accel_table[index];
+    buffer_is_zero_accel_large = accel_table[index_large];
+    return true;
+}
+
 static void __attribute__((constructor)) init_accel(void)
 {
-    accel_index = best_accel();
-    buffer_is_zero_accel = accel_table[accel_index];
+    unsigned index_large = best_accel_large();
+
+    /* the first call to test_buffer_is_zero_next_accel() selects it */
+    accel_index = index_large + 1;
+    buffer_is_zero_accel = accel_table[best_accel()];
+    buffer_is_zero_accel_large = accel_table[index_large];
 }
@@ -20,6 +20,9 @@
 #ifdef CONFIG_ELF_AUX_INFO
 #include <sys/auxv.h>
 #endif
+#ifndef HWCAP_SVE
+# define HWCAP_SVE 0  /* not provided by all C libraries */
+#endif
 #ifdef CONFIG_DARWIN
 # include <sys/sysctl.h>
 #endif
@@ -70,6 +73,7 @@ unsigned __attribute__((constructor)) cpuinfo_init(void)
     info |= (hwcap & HWCAP_USCAT ? CPUINFO_LSE2 : 0);
     info |= (hwcap & HWCAP_AES ? CPUINFO_AES : 0);
     info |= (hwcap & HWCAP_PMULL ? CPUINFO_PMULL : 0);
+    info |= (hwcap & HWCAP_SVE ? CPUINFO_SVE : 0);
 
     unsigned long hwcap2 = qemu_getauxval(AT_HWCAP2);
     info |= (hwcap2 & HWCAP2_BTI ? CPUINFO_BTI : 0);
@@ -870,6 +870,157 @@ IntervalTreeNode *interval_tree_iter_next(IntervalTreeNode *node,
     }
 }
 
+/*
+ * Interval trees that also track the size of the largest interval in
+ * each subtree, to find the first interval of a given size in O(log n).
+ */
+
+#define rb_to_sized(N)  container_of(rb_to_itree(N), IntervalTreeSizedNode, itree)
+
+static bool interval_tree_sized_compute(IntervalTreeSizedNode *node, bool exit)
+{
+    IntervalTreeSizedNode *child;
+    uint64_t max = node->itree.last;
+    uint64_t max_size = node->itree.last - node->itree.start;
+
+    if (node->itree.rb.rb_left) {
+        child = rb_to_sized(node->itree.rb.rb_left);
+        max = MAX(max, child->itree.subtree_last);
+        max_size = MAX(max_size, child->subtree_max_size);
+    }
+    if (node->itree.rb.rb_right) {
+        child = rb_to_sized(node->itree.rb.rb_right);
+        max = MAX(max, child->itree.subtree_last);
+        max_size = MAX(max_size, child->subtree_max_size);
+    }
+    if (exit && node->itree.subtree_last == max &&
+        node->subtree_max_size == max_size) {
+        return true;
+    }
+    node->itree.subtree_last = max;
+    node->subtree_max_size = max_size;
+    return false;
+}
+
+static void interval_tree_sized_propagate(RBNode *rb, RBNode *stop)
+{
+    while (rb != stop) {
+        IntervalTreeSizedNode *node = rb_to_sized(rb);
+        if (interval_tree_sized_compute(node, true)) {
+            break;
+        }
+        rb = rb_parent(&node->itree.rb);
+    }
+}
+
+static void interval_tree_sized_copy(RBNode *rb_old, RBNode *rb_new)
+{
+    IntervalTreeSizedNode *old = rb_to_sized(rb_old);
+    IntervalTreeSizedNode *new = rb_to_sized(rb_new);
+
+    new->itree.subtree_last = old->itree.subtree_last;
+    new->subtree_max_size = old->subtree_max_size;
+}
+
+static void interval_tree_sized_rotate(RBNode *rb_old, RBNode *rb_new)
+{
+    IntervalTreeSizedNode *old = rb_to_sized(rb_old);
+    IntervalTreeSizedNode *new = rb_to_sized(rb_new);
+
+    new->itree.subtree_last = old->itree.subtree_last;
+    new->subtree_max_size = old->subtree_max_size;
+    interval_tree_sized_compute(old, false);
+}
+
+static const RBAugmentCallbacks interval_tree_sized_augment = {
+    .propagate = interval_tree_sized_propagate,
+    .copy = interval_tree_sized_copy,
+    .rotate = interval_tree_sized_rotate,
+};
+
+void interval_tree_sized_insert(IntervalTreeSizedNode *node,
+                                IntervalTreeRoot *root)
+{
+    RBNode **link = &root->rb_root.rb_node, *rb_parent = NULL;
+    uint64_t start = node->itree.start, last = node->itree.last;
+    uint64_t size = last - start;
+    IntervalTreeSizedNode *parent;
+    bool leftmost = true;
+
+    while (*link) {
+        rb_parent = *link;
+        parent = rb_to_sized(rb_parent);
+
+        if (parent->itree.subtree_last < last) {
+            parent->itree.subtree_last = last;
+        }
+        if (parent->subtree_max_size < size) {
+            parent->subtree_max_size = size;
+        }
+        if (start < parent->itree.start) {
+            link = &parent->itree.rb.rb_left;
+        } else {
+            link = &parent->itree.rb.rb_right;
+            leftmost = false;
+        }
+    }
+
+    node->itree.subtree_last = last;
+    node->subtree_max_size = size;
+    rb_link_node(&node->itree.rb, rb_parent, link);
+    rb_insert_augmented_cached(&node->itree.rb, root, leftmost,
+                               &interval_tree_sized_augment);
+}
+
+void interval_tree_sized_remove(IntervalTreeSizedNode *node,
+                                IntervalTreeRoot *root)
+{
+    rb_erase_augmented_cached(&node->itree.rb, root,
+                              &interval_tree_sized_augment);
+}
+
+static IntervalTreeSizedNode *
+interval_tree_sized_subtree_fit(RBNode *rb, uint64_t start, uint64_t size)
+{
+    IntervalTreeSizedNode *node, *found;
+
+    if (!rb) {
+        return NULL;
+    }
+
+    /*
+     * Every interval of the subtree is too small, or does not have
+     * size + 1 locations at or after start.
+     */
+    node = rb_to_sized(rb);
+    if (node->subtree_max_size < size ||
+        node->itree.subtree_last < start ||
+        node->itree.subtree_last - start < size) {
+        return NULL;
+    }
+
+    found = interval_tree_sized_subtree_fit(node->itree.rb.rb_left,
+                                            start, size);
+    if (found) {
+        return found;
+    }
+
+    if (node->itree.last >= start &&
+        node->itree.last - MAX(node->itree.start, start) >= size) {
+        return node;
+    }
+
+    return interval_tree_sized_subtree_fit(node->itree.rb.rb_right,
+                                           start, size);
+}
+
+IntervalTreeSizedNode *interval_tree_sized_find_fit(IntervalTreeRoot *root,
+                                                    uint64_t start,
+                                                    uint64_t size)
+{
+    return interval_tree_sized_subtree_fit(root->rb_root.rb_node, start, size);
+}
+
 /* Occasionally useful for calling from within the debugger. */
 #if 0
 static void debug_interval_tree_int(IntervalTreeNode *node,
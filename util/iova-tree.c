@@ -11,48 +11,93 @@
 
 #include "qemu/osdep.h"
 #include "qemu/iova-tree.h"
+#include "qemu/interval-tree.h"
+
+/*
+ * A mapping stored in the tree.  The GTree key points to the DMAMap and
+ * frees it with g_free(), so map must be the first member.
+ */
+typedef struct IOVATreeMap {
+    DMAMap map;
+
+    /* Node in IOVATree.taddr_map, spanning the translated range */
+    IntervalTreeNode taddr;
+} IOVATreeMap;
 
 struct IOVATree {
     GTree *tree;
+
+    /* The mappings indexed by translated address */
+    IntervalTreeRoot taddr_map;
+
+    /*
+     * The unmapped IOVA ranges, as IntervalTreeSizedNode, so that
+     * iova_tree_alloc_map() does not have to walk all the mappings to
+     * find a hole.  Only kept for trees sorted by IOVA.
+     */
+    IntervalTreeRoot holes;
+    bool track_holes;
 };
 
-/* Args to pass to iova_tree_alloc foreach function. */
-struct IOVATreeAllocArgs {
-    /* Size of the desired allocation */
-    size_t new_size;
+static void iova_tree_hole_add(IOVATree *tree, hwaddr start, hwaddr last)
+{
+    IntervalTreeSizedNode *hole = g_new0(IntervalTreeSizedNode, 1);
 
-    /* The minimum address allowed in the allocation */
-    hwaddr iova_begin;
+    hole->itree.start = start;
+    hole->itree.last = last;
+    interval_tree_sized_insert(hole, &tree->holes);
+}
 
-    /* Map at the left of the hole, can be NULL if "this" is first one */
-    const DMAMap *prev;
+static IntervalTreeSizedNode *iova_tree_hole_find(IOVATree *tree, hwaddr addr)
+{
+    IntervalTreeNode *node = interval_tree_iter_first(&tree->holes, addr,
+                                                      addr);
 
-    /* Map at the right of the hole, can be NULL if "prev" is the last one */
-    const DMAMap *this;
+    return node ? container_of(node, IntervalTreeSizedNode, itree) : NULL;
+}
 
-    /* If found, we fill in the IOVA here */
-    hwaddr iova_result;
+static void iova_tree_hole_remove(IOVATree *tree, IntervalTreeSizedNode *hole)
+{
+    interval_tree_sized_remove(hole, &tree->holes);
+    g_free(hole);
+}
 
-    /* Whether have we found a valid IOVA */
-    bool iova_found;
-};
+/* Carve a new mapping, known not to overlap any other, out of its hole */
+static void iova_tree_reserve(IOVATree *tree, const DMAMap *map)
+{
+    hwaddr last = map->iova + map->size;
+    IntervalTreeSizedNode *hole = iova_tree_hole_find(tree, map->iova);
+    hwaddr hole_start, hole_last;
 
-typedef struct IOVATreeFindIOVAArgs {
-    const DMAMap *needle;
-    const DMAMap *result;
-} IOVATreeFindIOVAArgs;
+    assert(hole && hole->itree.last >= last);
 
-/**
- * Iterate args to the next hole
- *
- * @args: The alloc arguments
- * @next: The next mapping in the tree. Can be NULL to signal the last one
- */
-static void iova_tree_alloc_args_iterate(struct IOVATreeAllocArgs *args,
-                                         const DMAMap *next)
+    hole_start = hole->itree.start;
+    hole_last = hole->itree.last;
+    iova_tree_hole_remove(tree, hole);
+
+    if (hole_start < map->iova) {
+        iova_tree_hole_add(tree, hole_start, map->iova - 1);
+    }
+    if (last < hole_last) {
+        iova_tree_hole_add(tree, last + 1, hole_last);
+    }
+}
+
+/* Give back the range of a removed mapping, merging it with its neighbours */
+static void iova_tree_release(IOVATree *tree, const DMAMap *map)
 {
-    args->prev = args->this;
-    args->this = next;
+    hwaddr start = map->iova, last = map->iova + map->size;
+    IntervalTreeSizedNode *hole;
+
+    if (start > 0 && (hole = iova_tree_hole_find(tree, start - 1))) {
+        start = hole->itree.start;
+        iova_tree_hole_remove(tree, hole);
+    }
+    if (last < HWADDR_MAX && (hole = iova_tree_hole_find(tree, last + 1))) {
+        last = hole->itree.last;
+        iova_tree_hole_remove(tree, hole);
+    }
+    iova_tree_hole_add(tree, start, last);
 }
 
 static int iova_tree_compare(gconstpointer a, gconstpointer b, gpointer data)
@@ -78,6 +123,10 @@ IOVATree *iova_tree_new(void)
     /* We don't have values actually, no need to free */
     iova_tree->tree = g_tree_new_full(iova_tree_compare, NULL, g_free, NULL);
 
+    /* The whole IOVA space is free */
+    iova_tree->track_holes = true;
+    iova_tree_hole_add(iova_tree, 0, HWADDR_MAX);
+
     return iova_tree;
 }
 
@@ -86,45 +135,42 @@ const DMAMap *iova_tree_find(const IOVATree *tree, const DMAMap *map)
     return g_tree_lookup(tree->tree, map);
 }
 
-static gboolean iova_tree_find_address_iterator(gpointer key, gpointer value,
-                                                gpointer data)
+const DMAMap *iova_tree_find_iova(const IOVATree *tree, const DMAMap *map)
 {
-    const DMAMap *map = key;
-    IOVATreeFindIOVAArgs *args = data;
-    const DMAMap *needle;
+    hwaddr last = map->translated_addr + map->size;
+    IntervalTreeNode *node;
 
-    g_assert(key == value);
-
-    needle = args->needle;
-    if (map->translated_addr + map->size < needle->translated_addr ||
-        needle->translated_addr + needle->size < map->translated_addr) {
-        return false;
+    if (last < map->translated_addr) {
+        last = HWADDR_MAX;
     }
 
-    args->result = map;
-    return true;
+    node = interval_tree_iter_first((IntervalTreeRoot *)&tree->taddr_map,
+                                    map->translated_addr, last);
+    return node ? &container_of(node, IOVATreeMap, taddr)->map : NULL;
 }
 
-const DMAMap *iova_tree_find_iova(const IOVATree *tree, const DMAMap *map)
+static void iova_tree_insert_internal(IOVATree *tree, const DMAMap *map)
 {
-    IOVATreeFindIOVAArgs args = {
-        .needle = map,
-    };
+    IOVATreeMap *new = g_new0(IOVATreeMap, 1);
 
-    g_tree_foreach(tree->tree, iova_tree_find_address_iterator, &args);
-    return args.result;
-}
+    new->map = *map;
+    new->taddr.start = map->translated_addr;
+    new->taddr.last = map->translated_addr + map->size;
+    if (new->taddr.last < new->taddr.start) {
+        new->taddr.last = HWADDR_MAX;
+    }
+    interval_tree_insert(&new->taddr, &tree->taddr_map);
+
+    if (tree->track_holes) {
+        iova_tree_reserve(tree, map);
+    }
 
-static inline void iova_tree_insert_internal(GTree *gtree, DMAMap *range)
-{
     /* Key and value are sharing the same range data */
-    g_tree_insert(gtree, range, range);
+    g_tree_insert(tree->tree, &new->map, &new->map);
 }
 
 int iova_tree_insert(IOVATree *tree, const DMAMap *map)
 {
-    DMAMap *new;
-
     if (map->iova + map->size < map->iova || map->perm == IOMMU_NONE) {
         return IOVA_ERR_INVALID;
     }
@@ -134,9 +180,7 @@ int iova_tree_insert(IOVATree *tree, const DMAMap *map)
         return IOVA_ERR_OVERLAP;
     }
 
-    new = g_new0(DMAMap, 1);
-    memcpy(new, map, sizeof(*new));
-    iova_tree_insert_internal(tree->tree, new);
+    iova_tree_insert_internal(tree, map);
 
     return IOVA_OK;
 }
@@ -146,114 +190,51 @@ void iova_tree_remove(IOVATree *tree, DMAMap map)
     const DMAMap *overlap;
 
     while ((overlap = iova_tree_find(tree, &map))) {
-        g_tree_remove(tree->tree, overlap);
-    }
-}
-
-/**
- * Try to find an unallocated IOVA range between prev and this elements.
- *
- * @args: Arguments to allocation
- *
- * Cases:
- *
- * (1) !prev, !this: No entries allocated, always succeed
- *
- * (2) !prev, this: We're iterating at the 1st element.
- *
- * (3) prev, !this: We're iterating at the last element.
- *
- * (4) prev, this: this is the most common case, we'll try to find a hole
- * between "prev" and "this" mapping.
- *
- * Note that this function assumes the last valid iova is HWADDR_MAX, but it
- * searches linearly so it's easy to discard the result if it's not the case.
- */
-static void iova_tree_alloc_map_in_hole(struct IOVATreeAllocArgs *args)
-{
-    const DMAMap *prev = args->prev, *this = args->this;
-    uint64_t hole_start, hole_last;
-
-    if (this && this->iova + this->size < args->iova_begin) {
-        return;
-    }
+        IOVATreeMap *entry = container_of(overlap, IOVATreeMap, map);
 
-    hole_start = MAX(prev ? prev->iova + prev->size + 1 : 0, args->iova_begin);
-    hole_last = this ? this->iova : HWADDR_MAX;
-
-    if (hole_last - hole_start > args->new_size) {
-        args->iova_result = hole_start;
-        args->iova_found = true;
+        interval_tree_remove(&entry->taddr, &tree->taddr_map);
+        if (tree->track_holes) {
+            iova_tree_release(tree, overlap);
+        }
+        g_tree_remove(tree->tree, overlap);
     }
 }
 
-/**
- * Foreach dma node in the tree, compare if there is a hole with its previous
- * node (or minimum iova address allowed) and the node.
- *
- * @key: Node iterating
- * @value: Node iterating
- * @pargs: Struct to communicate with the outside world
- *
- * Return: false to keep iterating, true if needs break.
- */
-static gboolean iova_tree_alloc_traverse(gpointer key, gpointer value,
-                                         gpointer pargs)
-{
-    struct IOVATreeAllocArgs *args = pargs;
-    DMAMap *node = value;
-
-    assert(key == value);
-
-    iova_tree_alloc_args_iterate(args, node);
-    iova_tree_alloc_map_in_hole(args);
-    return args->iova_found;
-}
-
 int iova_tree_alloc_map(IOVATree *tree, DMAMap *map, hwaddr iova_begin,
                         hwaddr iova_last)
 {
-    struct IOVATreeAllocArgs args = {
-        .new_size = map->size,
-        .iova_begin = iova_begin,
-    };
+    IntervalTreeSizedNode *hole;
+    hwaddr iova;
+
+    assert(tree->track_holes);
 
     if (unlikely(iova_last < iova_begin)) {
         return IOVA_ERR_INVALID;
     }
 
-    /*
-     * Find a valid hole for the mapping
-     *
-     * Assuming low iova_begin, so no need to do a binary search to
-     * locate the first node.
-     *
-     * TODO: Replace all this with g_tree_node_first/next/last when available
-     * (from glib since 2.68). To do it with g_tree_foreach complicates the
-     * code a lot.
-     *
-     */
-    g_tree_foreach(tree->tree, iova_tree_alloc_traverse, &args);
-    if (!args.iova_found) {
-        /*
-         * Either tree is empty or the last hole is still not checked.
-         * g_tree_foreach does not compare (last, iova_last] range, so we check
-         * it here.
-         */
-        iova_tree_alloc_args_iterate(&args, NULL);
-        iova_tree_alloc_map_in_hole(&args);
+    /* Find the lowest hole for the mapping at or after iova_begin */
+    hole = interval_tree_sized_find_fit(&tree->holes, iova_begin, map->size);
+    if (!hole) {
+        return IOVA_ERR_NOMEM;
     }
 
-    if (!args.iova_found || args.iova_result + map->size > iova_last) {
+    iova = MAX(hole->itree.start, iova_begin);
+    if (iova + map->size > iova_last) {
         return IOVA_ERR_NOMEM;
     }
 
-    map->iova = args.iova_result;
+    map->iova = iova;
     return iova_tree_insert(tree, map);
 }
 
 void iova_tree_destroy(IOVATree *tree)
 {
+    IntervalTreeNode *node;
+
+    while ((node = interval_tree_iter_first(&tree->holes, 0, HWADDR_MAX))) {
+        iova_tree_hole_remove(tree,
+                              container_of(node, IntervalTreeSizedNode, itree));
+    }
     g_tree_destroy(tree->tree);
     g_free(tree);
 }
@@ -285,8 +266,6 @@ IOVATree *gpa_tree_new(void)
 
 int gpa_tree_insert(IOVATree *tree, const DMAMap *map)
 {
-    DMAMap *new;
-
     if (map->translated_addr + map->size < map->translated_addr ||
         map->perm == IOMMU_NONE) {
         return IOVA_ERR_INVALID;
@@ -297,9 +276,7 @@ int gpa_tree_insert(IOVATree *tree, const DMAMap *map)
         return IOVA_ERR_OVERLAP;
     }
 
-    new = g_new0(DMAMap, 1);
-    memcpy(new, map, sizeof(*new));
-    iova_tree_insert_internal(tree->tree, new);
+    iova_tree_insert_internal(tree, map);
 
     return IOVA_OK;
 }
@@ -22,8 +22,10 @@
  * - Writes (i.e. insertions/removals) can be concurrent with writes to
  *   different buckets; writes to the same bucket are serialized through a lock.
  * - Optional auto-resizing: the hash table resizes up if the load surpasses
- *   a certain threshold. Resizing is done concurrently with readers; writes
- *   are serialized with the resize operation.
+ *   a certain threshold. Auto-resizing is incremental: it is done concurrently
+ *   with both readers and writers, and writers help complete it.
+ *   Explicit resizes (qht_resize/qht_reset_size) are done concurrently with
+ *   readers; writes are serialized with the resize operation.
  *
  * The key structure is the bucket, which is cacheline-sized. Buckets
  * contain a few hash values and pointers; the u32 hash values are stored in
@@ -43,10 +45,25 @@
  * just-removed entry. This makes lookups slightly faster, since the moment an
  * invalid entry is found, the (failed) lookup is over.
  *
- * Resizing is done by taking all bucket spinlocks (so that no other writers can
- * race with us) and then copying all entries into a new hash map. Then, the
- * ht->map pointer is set, and the old map is freed once no RCU readers can see
- * it anymore.
+ * Explicit resizing is done by taking all bucket spinlocks (so that no other
+ * writers can race with us) and then copying all entries into a new hash map.
+ * Then, the ht->map pointer is set, and the old map is freed once no RCU
+ * readers can see it anymore.
+ *
+ * Auto-resizing instead doubles the number of head buckets without stopping
+ * writers. The new map is published right away, with a pointer to the old map
+ * in new->old. Old head bucket i then migrates, under its lock, to new head
+ * buckets i and i + old->n_buckets; a per-bucket "migrated" bit is set in the
+ * old map once this is done. For any hash, the authoritative bucket is thus
+ * the old one until it has been migrated, and the new one afterwards:
+ * - Lookups check the old bucket's migrated bit under the old bucket's
+ *   seqlock, and look up the new map if the bit is set.
+ * - Writers migrate the old bucket of the hash they are about to modify
+ *   before locking the new bucket, plus a small batch of not-yet-migrated
+ *   buckets. The writer that migrates the last bucket clears new->old and
+ *   frees the old map once no RCU readers can see it anymore.
+ * Operations that need to see the whole map at once (iterators, resets,
+ * explicit resizes) complete any pending migration first.
  *
  * Writers check for concurrent resizes by comparing ht->map before and after
  * acquiring their bucket lock. If they don't match, a resize has occurred
@@ -70,6 +87,7 @@
 #include "qemu/atomic.h"
 #include "qemu/rcu.h"
 #include "qemu/memalign.h"
+#include "qemu/bitmap.h"
 
 //#define QHT_DEBUG
 
@@ -176,6 +194,13 @@ struct qht_tsan_lock {
  * @n_added_buckets: number of added (i.e. "non-head") buckets
  * @n_added_buckets_threshold: threshold to trigger an upward resize once the
  *                             number of added buckets surpasses it.
+ * @old: map being incrementally migrated into this one, or NULL.
+ * @migrated: bitmap of head buckets that have already been migrated into
+ *            the map that replaces this one. Only allocated once this map
+ *            starts being migrated.
+ * @migrate_next: index of the next @old head bucket to be claimed by a writer
+ *                helping with the migration.
+ * @n_migrated: number of @old head buckets migrated so far.
  * @tsan_bucket_locks: Array of striped locks to be used only under TSAN.
  *
  * Buckets are tracked in what we call a "map", i.e. this structure.
@@ -186,6 +211,10 @@ struct qht_map {
     size_t n_buckets;
     size_t n_added_buckets;
     size_t n_added_buckets_threshold;
+    struct qht_map *old;
+    unsigned long *migrated;
+    size_t migrate_next;
+    size_t n_migrated;
 #ifdef CONFIG_TSAN
     struct qht_tsan_lock tsan_bucket_locks[QHT_TSAN_BUCKET_LOCKS];
 #endif
@@ -194,9 +223,19 @@ struct qht_map {
 /* trigger a resize when n_added_buckets > n_buckets / div */
 #define QHT_NR_ADDED_BUCKETS_THRESHOLD_DIV 8
 
+/*
+ * Number of old head buckets that a writer migrates, on top of the one it
+ * needs, every time it finds an incremental resize in progress.
+ */
+#define QHT_MIGRATE_BATCH 8
+
 static void qht_do_resize_reset(struct qht *ht, struct qht_map *new,
                                 bool reset);
 static void qht_grow_maybe(struct qht *ht);
+static void qht_map_destroy(struct qht_map *map);
+static void *qht_insert__locked(const struct qht *ht, struct qht_map *map,
+                                struct qht_bucket *head, void *p, uint32_t hash,
+                                bool *needs_resize);
 
 #ifdef QHT_DEBUG
 
@@ -295,6 +334,41 @@ static inline void qht_bucket_unlock(struct qht_map *map,
     qht_bucket_lock_do(map, b, qemu_spin_unlock);
 }
 
+/* under TSAN, two different buckets might map to the same striped lock */
+static inline bool qht_bucket_lock_is_shared(struct qht_map *map,
+                                             struct qht_bucket *a,
+                                             struct qht_bucket *b)
+{
+#ifdef CONFIG_TSAN
+    unsigned long a_idx = a - map->buckets;
+    unsigned long b_idx = b - map->buckets;
+
+    return ((a_idx ^ b_idx) & (QHT_TSAN_BUCKET_LOCKS - 1)) == 0;
+#else
+    return a == b;
+#endif
+}
+
+static inline void qht_bucket_lock_pair(struct qht_map *map,
+                                        struct qht_bucket *a,
+                                        struct qht_bucket *b)
+{
+    qht_bucket_lock(map, a);
+    if (!qht_bucket_lock_is_shared(map, a, b)) {
+        qht_bucket_lock(map, b);
+    }
+}
+
+static inline void qht_bucket_unlock_pair(struct qht_map *map,
+                                          struct qht_bucket *a,
+                                          struct qht_bucket *b)
+{
+    if (!qht_bucket_lock_is_shared(map, a, b)) {
+        qht_bucket_unlock(map, b);
+    }
+    qht_bucket_unlock(map, a);
+}
+
 static inline void qht_head_init(struct qht_map *map, struct qht_bucket *b)
 {
     memset(b, 0, sizeof(*b));
@@ -331,6 +405,145 @@ static void qht_map_unlock_buckets(struct qht_map *map)
     }
 }
 
+static inline bool qht_map_bucket_migrated(const struct qht_map *old,
+                                           size_t idx)
+{
+    unsigned long word = qatomic_load_acquire(&old->migrated[BIT_WORD(idx)]);
+
+    return word & BIT_MASK(idx);
+}
+
+/*
+ * Migrate head bucket @idx of @old, together with its chain, into @map.
+ * Entries in old bucket i can only end up in new buckets i and
+ * i + old->n_buckets, since the new map has twice as many buckets.
+ *
+ * Returns true if this was the last bucket of @old to be migrated.
+ */
+static bool qht_map_migrate_bucket(const struct qht *ht, struct qht_map *map,
+                                   struct qht_map *old, size_t idx)
+{
+    struct qht_bucket *head = &old->buckets[idx];
+    struct qht_bucket *lo = &map->buckets[idx];
+    struct qht_bucket *hi = &map->buckets[idx + old->n_buckets];
+    struct qht_bucket *b = head;
+    int i;
+
+    qht_bucket_lock(old, head);
+    if (test_bit(idx, old->migrated)) {
+        qht_bucket_unlock(old, head);
+        return false;
+    }
+    qht_bucket_lock_pair(map, lo, hi);
+    do {
+        for (i = 0; i < QHT_BUCKET_ENTRIES; i++) {
+            if (b->pointers[i] == NULL) {
+                goto done;
+            }
+            qht_insert__locked(ht, map, (b->hashes[i] & old->n_buckets) ?
+                               hi : lo, b->pointers[i], b->hashes[i], NULL);
+        }
+        b = b->next;
+    } while (b);
+ done:
+    /*
+     * The old entries are left in place: readers that see the bit set will
+     * look them up in @map, and those that don't will find them here.
+     */
+    seqlock_write_begin(&head->sequence);
+    set_bit_atomic(idx, old->migrated);
+    seqlock_write_end(&head->sequence);
+    qht_bucket_debug__locked(lo);
+    qht_bucket_debug__locked(hi);
+    qht_bucket_unlock_pair(map, lo, hi);
+    qht_bucket_unlock(old, head);
+
+    return qatomic_fetch_inc(&map->n_migrated) + 1 == old->n_buckets;
+}
+
+/* call with ht->lock held */
+static void qht_map_migration_done__locked(struct qht_map *map,
+                                           struct qht_map *old)
+{
+    /* another thread might have completed the migration already */
+    if (map->old != old) {
+        return;
+    }
+    qatomic_rcu_set(&map->old, NULL);
+    call_rcu(old, qht_map_destroy, rcu);
+}
+
+static void qht_map_migration_done(struct qht *ht, struct qht_map *map,
+                                   struct qht_map *old)
+{
+    qht_lock(ht);
+    qht_map_migration_done__locked(map, old);
+    qht_unlock(ht);
+}
+
+/*
+ * Make sure the head bucket for @hash in @map is authoritative, i.e. that the
+ * corresponding bucket in map->old (if any) has been migrated. While at it,
+ * help the ongoing migration by migrating a few more buckets.
+ *
+ * Note: callers cannot have ht->lock held.
+ */
+static inline void qht_map_migrate_maybe(struct qht *ht, struct qht_map *map,
+                                         uint32_t hash)
+{
+    struct qht_map *old = qatomic_rcu_read(&map->old);
+    size_t idx, end;
+    bool done;
+
+    if (likely(old == NULL)) {
+        return;
+    }
+    done = qht_map_migrate_bucket(ht, map, old, hash & (old->n_buckets - 1));
+
+    idx = qatomic_fetch_add(&map->migrate_next, QHT_MIGRATE_BATCH);
+    end = MIN(idx + QHT_MIGRATE_BATCH, old->n_buckets);
+    for (; idx < end; idx++) {
+        done |= qht_map_migrate_bucket(ht, map, old, idx);
+    }
+
+    if (done) {
+        qht_map_migration_done(ht, map, old);
+    }
+}
+
+/* complete any ongoing migration. Call with ht->lock held. */
+static void qht_map_migrate_all__locked(struct qht *ht)
+{
+    struct qht_map *map = ht->map;
+    struct qht_map *old = map->old;
+    size_t i;
+
+    if (old == NULL) {
+        return;
+    }
+    for (i = 0; i < old->n_buckets; i++) {
+        qht_map_migrate_bucket(ht, map, old, i);
+    }
+    qht_map_migration_done__locked(map, old);
+}
+
+/*
+ * Start an incremental migration of ht->map into @new, which must have
+ * twice as many head buckets. Call with ht->lock held.
+ */
+static void qht_map_migrate_begin__locked(struct qht *ht, struct qht_map *new)
+{
+    struct qht_map *old = ht->map;
+
+    g_assert(old->old == NULL);
+    g_assert(new->n_buckets == old->n_buckets * 2);
+
+    old->migrated = bitmap_new(old->n_buckets);
+    new->old = old;
+    /* pairs with qatomic_rcu_read of ht->map and then map->old */
+    qatomic_rcu_set(&ht->map, new);
+}
+
 /*
  * Call with at least a bucket lock held.
  * @map should be the value read before acquiring the lock (or locks).
@@ -342,7 +555,8 @@ static inline bool qht_map_is_stale__locked(const struct qht *ht,
 }
 
 /*
- * Grab all bucket locks, and set @pmap after making sure the map isn't stale.
+ * Grab all bucket locks, and set @pmap after making sure the map isn't stale
+ * and that it holds all entries, i.e. that no migration is in progress.
  *
  * Pairs with qht_map_unlock_buckets(), hence the pass-by-reference.
  *
@@ -355,14 +569,19 @@ void qht_map_lock_buckets__no_stale(struct qht *ht, struct qht_map **pmap)
 
     map = qatomic_rcu_read(&ht->map);
     qht_map_lock_buckets(map);
-    if (likely(!qht_map_is_stale__locked(ht, map))) {
+    if (likely(!qht_map_is_stale__locked(ht, map) &&
+               qatomic_read(&map->old) == NULL)) {
         *pmap = map;
         return;
     }
     qht_map_unlock_buckets(map);
 
-    /* we raced with a resize; acquire ht->lock to see the updated ht->map */
+    /*
+     * We raced with a resize; acquire ht->lock to see the updated ht->map,
+     * and complete its migration if it is still ongoing.
+     */
     qht_lock(ht);
+    qht_map_migrate_all__locked(ht);
     map = ht->map;
     qht_map_lock_buckets(map);
     qht_unlock(ht);
@@ -385,6 +604,7 @@ struct qht_bucket *qht_bucket_lock__no_stale(struct qht *ht, uint32_t hash,
     struct qht_map *map;
 
     map = qatomic_rcu_read(&ht->map);
+    qht_map_migrate_maybe(ht, map, hash);
     b = qht_map_to_bucket(map, hash);
 
     qht_bucket_lock(map, b);
@@ -397,6 +617,11 @@ struct qht_bucket *qht_bucket_lock__no_stale(struct qht *ht, uint32_t hash,
     /* we raced with a resize; acquire ht->lock to see the updated ht->map */
     qht_lock(ht);
     map = ht->map;
+    if (map->old &&
+        qht_map_migrate_bucket(ht, map, map->old,
+                               hash & (map->old->n_buckets - 1))) {
+        qht_map_migration_done__locked(map, map->old);
+    }
     b = qht_map_to_bucket(map, hash);
     qht_bucket_lock(map, b);
     qht_unlock(ht);
@@ -433,6 +658,7 @@ static void qht_map_destroy(struct qht_map *map)
         qht_chain_destroy(map, &map->buckets[i]);
     }
     qemu_vfree(map->buckets);
+    g_free(map->migrated);
     g_free(map);
 }
 
@@ -445,6 +671,10 @@ static struct qht_map *qht_map_create(size_t n_buckets)
     map->n_buckets = n_buckets;
 
     map->n_added_buckets = 0;
+    map->old = NULL;
+    map->migrated = NULL;
+    map->migrate_next = 0;
+    map->n_migrated = 0;
     map->n_added_buckets_threshold = n_buckets /
         QHT_NR_ADDED_BUCKETS_THRESHOLD_DIV;
 
@@ -478,6 +708,9 @@ void qht_init(struct qht *ht, qht_cmp_func_t cmp, size_t n_elems,
 /* call only when there are no readers/writers left */
 void qht_destroy(struct qht *ht)
 {
+    if (ht->map->old) {
+        qht_map_destroy(ht->map->old);
+    }
     qht_map_destroy(ht->map);
     memset(ht, 0, sizeof(*ht));
 }
@@ -592,15 +825,14 @@ void *qht_lookup__slowpath(const struct qht_bucket *b, qht_lookup_func_t func,
     return ret;
 }
 
-void *qht_lookup_custom(const struct qht *ht, const void *userp, uint32_t hash,
-                        qht_lookup_func_t func)
+static inline
+void *qht_map_lookup(const struct qht_map *map, const void *userp,
+                     uint32_t hash, qht_lookup_func_t func)
 {
     const struct qht_bucket *b;
-    const struct qht_map *map;
     unsigned int version;
     void *ret;
 
-    map = qatomic_rcu_read(&ht->map);
     b = qht_map_to_bucket(map, hash);
 
     version = seqlock_read_begin(&b->sequence);
@@ -615,6 +847,44 @@ void *qht_lookup_custom(const struct qht *ht, const void *userp, uint32_t hash,
     return qht_lookup__slowpath(b, func, userp, hash);
 }
 
+/*
+ * Look up @hash while @map is being migrated from @old: the old bucket is
+ * authoritative until its migrated bit is set.
+ */
+static __attribute__((noinline))
+void *qht_lookup__migrating(const struct qht_map *map,
+                            const struct qht_map *old, const void *userp,
+                            uint32_t hash, qht_lookup_func_t func)
+{
+    size_t idx = hash & (old->n_buckets - 1);
+    const struct qht_bucket *b = &old->buckets[idx];
+    unsigned int version;
+    void *ret;
+
+    do {
+        version = seqlock_read_begin(&b->sequence);
+        if (qht_map_bucket_migrated(old, idx)) {
+            return qht_map_lookup(map, userp, hash, func);
+        }
+        ret = qht_do_lookup(b, func, userp, hash);
+    } while (seqlock_read_retry(&b->sequence, version));
+    return ret;
+}
+
+void *qht_lookup_custom(const struct qht *ht, const void *userp, uint32_t hash,
+                        qht_lookup_func_t func)
+{
+    const struct qht_map *map;
+    const struct qht_map *old;
+
+    map = qatomic_rcu_read(&ht->map);
+    old = qatomic_rcu_read(&map->old);
+    if (unlikely(old)) {
+        return qht_lookup__migrating(map, old, userp, hash, func);
+    }
+    return qht_map_lookup(map, userp, hash, func);
+}
+
 void *qht_lookup(const struct qht *ht, const void *userp, uint32_t hash)
 {
     return qht_lookup_custom(ht, userp, hash, ht->cmp);
@@ -682,11 +952,15 @@ static __attribute__((noinline)) void qht_grow_maybe(struct qht *ht)
         return;
     }
     map = ht->map;
-    /* another thread might have just performed the resize we were after */
-    if (qht_map_needs_resize(map)) {
+    /*
+     * Another thread might have just started the resize we were after.
+     * If the previous resize is still being migrated, let writers finish it
+     * before starting another one.
+     */
+    if (qht_map_needs_resize(map) && map->old == NULL) {
         struct qht_map *new = qht_map_create(map->n_buckets * 2);
 
-        qht_do_resize(ht, new);
+        qht_map_migrate_begin__locked(ht, new);
     }
     qht_unlock(ht);
 }
@@ -871,8 +1145,7 @@ do_qht_iter(struct qht *ht, const struct qht_iter *iter, void *userp)
 {
     struct qht_map *map;
 
-    map = qatomic_rcu_read(&ht->map);
-    qht_map_lock_buckets(map);
+    qht_map_lock_buckets__no_stale(ht, &map);
     qht_map_iter__all_locked(map, iter, userp);
     qht_map_unlock_buckets(map);
 }
@@ -926,6 +1199,7 @@ static void qht_do_resize_reset(struct qht *ht, struct qht_map *new, bool reset)
     };
     struct qht_map_copy_data data;
 
+    qht_map_migrate_all__locked(ht);
     old = ht->map;
     qht_map_lock_buckets(old);
 
@@ -967,10 +1241,41 @@ bool qht_resize(struct qht *ht, size_t n_elems)
     return ret;
 }
 
+static void qht_chain_statistics(const struct qht_bucket *head,
+                                 size_t *pbuckets, size_t *pentries)
+{
+    const struct qht_bucket *b;
+    unsigned int version;
+    size_t buckets;
+    size_t entries;
+    int j;
+
+    do {
+        version = seqlock_read_begin(&head->sequence);
+        buckets = 0;
+        entries = 0;
+        b = head;
+        do {
+            for (j = 0; j < QHT_BUCKET_ENTRIES; j++) {
+                if (qatomic_read(&b->pointers[j]) == NULL) {
+                    break;
+                }
+                entries++;
+            }
+            buckets++;
+            b = qatomic_rcu_read(&b->next);
+        } while (b);
+    } while (seqlock_read_retry(&head->sequence, version));
+
+    *pbuckets = buckets;
+    *pentries = entries;
+}
+
 /* pass @stats to qht_statistics_destroy() when done */
 void qht_statistics_init(const struct qht *ht, struct qht_stats *stats)
 {
     const struct qht_map *map;
+    const struct qht_map *old;
     int i;
 
     map = qatomic_rcu_read(&ht->map);
@@ -987,30 +1292,10 @@ void qht_statistics_init(const struct qht *ht, struct qht_stats *stats)
     stats->head_buckets = map->n_buckets;
 
     for (i = 0; i < map->n_buckets; i++) {
-        const struct qht_bucket *head = &map->buckets[i];
-        const struct qht_bucket *b;
-        unsigned int version;
         size_t buckets;
         size_t entries;
-        int j;
-
-        do {
-            version = seqlock_read_begin(&head->sequence);
-            buckets = 0;
-            entries = 0;
-            b = head;
-            do {
-                for (j = 0; j < QHT_BUCKET_ENTRIES; j++) {
-                    if (qatomic_read(&b->pointers[j]) == NULL) {
-                        break;
-                    }
-                    entries++;
-                }
-                buckets++;
-                b = qatomic_rcu_read(&b->next);
-            } while (b);
-        } while (seqlock_read_retry(&head->sequence, version));
 
+        qht_chain_statistics(&map->buckets[i], &buckets, &entries);
         if (entries) {
             qdist_inc(&stats->chain, buckets);
             qdist_inc(&stats->occupancy,
@@ -1021,6 +1306,21 @@ void qht_statistics_init(const struct qht *ht, struct qht_stats *stats)
             qdist_inc(&stats->occupancy, 0);
         }
     }
+
+    /* entries not yet migrated from the old map only count as entries */
+    old = qatomic_rcu_read(&map->old);
+    if (unlikely(old)) {
+        for (i = 0; i < old->n_buckets; i++) {
+            size_t buckets;
+            size_t entries;
+
+            if (qht_map_bucket_migrated(old, i)) {
+                continue;
+            }
+            qht_chain_statistics(&old->buckets[i], &buckets, &entries);
+            stats->entries += entries;
+        }
+    }
 }
 
 void qht_statistics_destroy(struct qht_stats *stats)
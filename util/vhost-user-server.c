@@ -8,6 +8,7 @@
  * later.  See the COPYING file in the top-level directory.
  */
 #include "qemu/osdep.h"
+#include "qemu/defer-call.h"
 #include "qemu/error-report.h"
 #include "qemu/main-loop.h"
 #include "qemu/vhost-user-server.h"
@@ -27,7 +28,9 @@
  * protocol messages over the UNIX domain socket.
  *
  * When virtqueues are set up libvhost-user calls set_watch() to monitor kick
- * fds. These fds are also handled in the VuServer->ctx AioContext.
+ * fds. These fds are also handled in the VuServer->ctx AioContext. If the
+ * AioContext polls, the avail rings are busy-polled instead and guest kicks
+ * are suppressed for as long as polling goes on.
  *
  * Both vu_client_trip() and kick fd monitoring can be stopped by shutting down
  * the socket connection. Shutting down the socket connection causes
@@ -250,6 +253,23 @@ static coroutine_fn void vu_client_trip(void *opaque)
     aio_wait_kick();
 }
 
+static void vu_fd_watch_check_broken(VuFdWatch *vu_fd_watch)
+{
+    VuDev *vu_dev = vu_fd_watch->vu_dev;
+
+    /* Stop vu_client_trip() if an error occurred in the queue handler */
+    if (vu_dev->broken) {
+        VuServer *server = container_of(vu_dev, VuServer, vu_dev);
+
+        qio_channel_shutdown(server->ioc, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
+    }
+}
+
+static VuVirtq *vu_fd_watch_get_queue(VuFdWatch *vu_fd_watch)
+{
+    return vu_get_queue(vu_fd_watch->vu_dev, (intptr_t)vu_fd_watch->pvt);
+}
+
 /*
  * a wrapper for vu_kick_cb
  *
@@ -257,21 +277,80 @@ static coroutine_fn void vu_client_trip(void *opaque)
  * callback function, pack VuDev and pvt into a struct. Then unpack it
  * and pass them to vu_kick_cb
  */
-static void kick_handler(void *opaque)
+static void kick_handler(EventNotifier *e)
 {
-    VuFdWatch *vu_fd_watch = opaque;
-    VuDev *vu_dev = vu_fd_watch->vu_dev;
+    VuFdWatch *vu_fd_watch = container_of(e, VuFdWatch, notifier);
 
-    vu_fd_watch->cb(vu_dev, 0, vu_fd_watch->pvt);
+    vu_fd_watch->cb(vu_fd_watch->vu_dev, 0, vu_fd_watch->pvt);
+    vu_fd_watch_check_broken(vu_fd_watch);
+}
 
-    /* Stop vu_client_trip() if an error occurred in vu_fd_watch->cb() */
-    if (vu_dev->broken) {
-        VuServer *server = container_of(vu_dev, VuServer, vu_dev);
+static bool kick_poll(void *opaque)
+{
+    VuFdWatch *vu_fd_watch = container_of(opaque, VuFdWatch, notifier);
+    VuVirtq *vq = vu_fd_watch_get_queue(vu_fd_watch);
 
-        qio_channel_shutdown(server->ioc, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
+    return vq->handler && !vu_queue_empty(vu_fd_watch->vu_dev, vq);
+}
+
+/* Process the avail ring without waiting for the kick */
+static void kick_poll_ready(EventNotifier *e)
+{
+    VuFdWatch *vu_fd_watch = container_of(e, VuFdWatch, notifier);
+    VuVirtq *vq = vu_fd_watch_get_queue(vu_fd_watch);
+
+    if (vq->handler) {
+        vq->handler(vu_fd_watch->vu_dev, (intptr_t)vu_fd_watch->pvt);
+        vu_fd_watch_check_broken(vu_fd_watch);
+    }
+}
+
+static void kick_poll_begin(EventNotifier *e)
+{
+    VuFdWatch *vu_fd_watch = container_of(e, VuFdWatch, notifier);
+    VuVirtq *vq = vu_fd_watch_get_queue(vu_fd_watch);
+
+    if (vu_queue_started(vu_fd_watch->vu_dev, vq)) {
+        vu_queue_set_notification(vu_fd_watch->vu_dev, vq, 0);
+    }
+}
+
+/* The AioContext polls once more after this to catch racing requests */
+static void kick_poll_end(EventNotifier *e)
+{
+    VuFdWatch *vu_fd_watch = container_of(e, VuFdWatch, notifier);
+    VuVirtq *vq = vu_fd_watch_get_queue(vu_fd_watch);
+
+    if (vu_queue_started(vu_fd_watch->vu_dev, vq)) {
+        vu_queue_set_notification(vu_fd_watch->vu_dev, vq, 1);
     }
 }
 
+static void vu_fd_watch_attach(VuFdWatch *vu_fd_watch, AioContext *ctx)
+{
+    VuVirtq *vq = vu_fd_watch_get_queue(vu_fd_watch);
+
+    aio_set_event_notifier(ctx, &vu_fd_watch->notifier, kick_handler,
+                           kick_poll, kick_poll_ready);
+    aio_set_event_notifier_poll(ctx, &vu_fd_watch->notifier,
+                                kick_poll_begin, kick_poll_end);
+
+    /*
+     * kick_poll_end() is not called when detaching in the middle of a
+     * polling section.  Re-enable notifications and look for requests
+     * that were submitted without a kick in the meantime.
+     */
+    if (vu_queue_started(vu_fd_watch->vu_dev, vq) && !vq->notification) {
+        vu_queue_set_notification(vu_fd_watch->vu_dev, vq, 1);
+        event_notifier_set(&vu_fd_watch->notifier);
+    }
+}
+
+static void vu_fd_watch_detach(VuFdWatch *vu_fd_watch, AioContext *ctx)
+{
+    aio_set_event_notifier(ctx, &vu_fd_watch->notifier, NULL, NULL, NULL);
+}
+
 static VuFdWatch *find_vu_fd_watch(VuServer *server, int fd)
 {
 
@@ -284,6 +363,30 @@ static VuFdWatch *find_vu_fd_watch(VuServer *server, int fd)
     return NULL;
 }
 
+static void vu_fd_watch_notify_deferred_fn(void *opaque)
+{
+    VuFdWatch *vu_fd_watch = opaque;
+
+    vu_queue_notify(vu_fd_watch->vu_dev, vu_fd_watch_get_queue(vu_fd_watch));
+}
+
+/*
+ * Signal the call fd of @vq for completions pushed to its used ring.
+ * Inside a defer_call_begin()/defer_call_end() section all completions of
+ * the section share one check of the used event and one eventfd write.
+ */
+void vhost_user_server_queue_notify(VuServer *server, VuVirtq *vq)
+{
+    VuFdWatch *vu_fd_watch = find_vu_fd_watch(server, vq->kick_fd);
+
+    if (!vu_fd_watch) {
+        vu_queue_notify(&server->vu_dev, vq);
+        return;
+    }
+
+    defer_call(vu_fd_watch_notify_deferred_fn, vu_fd_watch);
+}
+
 static void
 set_watch(VuDev *vu_dev, int fd, int vu_evt,
           vu_watch_cb cb, void *pvt)
@@ -304,10 +407,10 @@ set_watch(VuDev *vu_dev, int fd, int vu_evt,
         vu_fd_watch->fd = fd;
         vu_fd_watch->cb = cb;
         qemu_socket_set_nonblock(fd);
-        aio_set_fd_handler(server->ctx, fd, kick_handler,
-                           NULL, NULL, NULL, vu_fd_watch);
+        event_notifier_init_fd(&vu_fd_watch->notifier, fd);
         vu_fd_watch->vu_dev = vu_dev;
         vu_fd_watch->pvt = pvt;
+        vu_fd_watch_attach(vu_fd_watch, server->ctx);
     }
 }
 
@@ -325,7 +428,7 @@ static void remove_watch(VuDev *vu_dev, int fd)
     if (!vu_fd_watch) {
         return;
     }
-    aio_set_fd_handler(server->ctx, fd, NULL, NULL, NULL, NULL, NULL);
+    vu_fd_watch_detach(vu_fd_watch, server->ctx);
 
     QTAILQ_REMOVE(&server->vu_fd_watches, vu_fd_watch, next);
     g_free(vu_fd_watch);
@@ -385,8 +488,7 @@ void vhost_user_server_stop(VuServer *server)
         VuFdWatch *vu_fd_watch;
 
         QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-            aio_set_fd_handler(server->ctx, vu_fd_watch->fd,
-                               NULL, NULL, NULL, NULL, vu_fd_watch);
+            vu_fd_watch_detach(vu_fd_watch, server->ctx);
         }
 
         qio_channel_shutdown(server->ioc, QIO_CHANNEL_SHUTDOWN_BOTH, NULL);
@@ -424,8 +526,7 @@ void vhost_user_server_attach_aio_context(VuServer *server, AioContext *ctx)
     }
 
     QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-        aio_set_fd_handler(ctx, vu_fd_watch->fd, kick_handler, NULL,
-                           NULL, NULL, vu_fd_watch);
+        vu_fd_watch_attach(vu_fd_watch, ctx);
     }
 
     if (server->co_trip) {
@@ -456,8 +557,7 @@ void vhost_user_server_detach_aio_context(VuServer *server)
         VuFdWatch *vu_fd_watch;
 
         QTAILQ_FOREACH(vu_fd_watch, &server->vu_fd_watches, next) {
-            aio_set_fd_handler(server->ctx, vu_fd_watch->fd,
-                               NULL, NULL, NULL, NULL, vu_fd_watch);
+            vu_fd_watch_detach(vu_fd_watch, server->ctx);
         }
     }
 